@@ -1,3 +1,6 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,14 +8,234 @@
 
 #include "bbsearch.h"
 #include "dag.h"
+#include "dist.h"
+#include "local.h"
 #include "parser.h"
+#include "serve.h"
+#include "trace.h"
+
+// number of makespans the server remembers
+#define CACHE_SIZE (4096)
+
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the time to measure searches by: the CPU time of the process, or
+// the wall clock for searches that run on several threads at once,
+// which `threaded' is set for. The probe threads of PROBES run
+// alongside every search, so with PROBES it is always the wall clock.
+static double search_time(int threaded) {
+#ifdef PROBES
+    threaded = 1;
+#endif
+    return threaded ? wall_time() : (double) clock() / CLOCKS_PER_SEC;
+}
+
+// parse `file', dropping redundant edges if built with REDUCE and
+// renumbering the vertices by level if built with RENUMBER.
+static int load(const char *file, dag **g) {
+    if (parse_patterson(file, g) != 0) {
+        return -1;
+    }
+#ifdef REDUCE
+    size_t removed;
+    if (dag_build_reduced(*g, &removed) != 0) {
+        dag_destroy(*g);
+        return -1;
+    }
+    fprintf(stderr, "%zu redundant edges removed\n", removed);
+#endif
+#ifdef RENUMBER
+    if (dag_renumber(*g, DAG_NUMBER_LEVEL) != 0) {
+        dag_destroy(*g);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+static void on_signal(int sig) {
+    bbsearch_interrupt();
+}
+
+// search for the makespan of `file', saving the search to
+// `checkpoint' if it does not finish and continuing from there if it
+// exists.
+static int resumable(const char *checkpoint, const char *file, int m,
+                     int timeout) {
+    dag *g;
+    if (load(file, &g) != 0) {
+        printf("Parse failed\n");
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    double start = search_time(0);
+    int result = bbsearch_resumable(g, m, timeout, checkpoint);
+    double t = search_time(0) - start;
+    printf("%s, %zu, %u, %d, %f\n", file, dag_size(g) - 2, m, result, t);
+    dag_destroy(g);
+    return (result == -1) ? 1 : 0;
+}
+
+// search for the makespan of `file', recording every node in the trace
+// file `path'.
+static int traced(const char *path, const char *file, int m, int timeout) {
+    dag *g;
+    if (load(file, &g) != 0) {
+        printf("Parse failed\n");
+        return 1;
+    }
+    if (bbsearch_trace(path) != 0) {
+        printf("Cannot open %s\n", path);
+        dag_destroy(g);
+        return 1;
+    }
+    double start = search_time(0);
+    int result = bbsearch(g, m, timeout);
+    double t = search_time(0) - start;
+    int err = bbsearch_trace(NULL);
+    printf("%s, %zu, %u, %d, %f\n", file, dag_size(g) - 2, m, result, t);
+    dag_destroy(g);
+    if (err != 0) {
+        printf("Trace write failed\n");
+    }
+    return (result == -1 || err != 0) ? 1 : 0;
+}
+
+// search for the makespan of `file' with the workers that connect to
+// `port'.
+static int coordinate(const char *port, const char *file, int m,
+                      int timeout) {
+    dag *g;
+    if (load(file, &g) != 0) {
+        printf("Parse failed\n");
+        return 1;
+    }
+    double start = wall_time();
+    int result = dist_coordinate(g, m, timeout, port);
+    double t = wall_time() - start;
+    printf("%s, %zu, %u, %d, %f\n", file, dag_size(g) - 2, m, result, t);
+    dag_destroy(g);
+    return (result == -1) ? 1 : 0;
+}
+
+// print the trace file `path' as comma separated lines.
+static int decode(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("Cannot open %s\n", path);
+        return 1;
+    }
+    int err = trace_decode(f, stdout);
+    fclose(f);
+    if (err != 0) {
+        fprintf(stderr, "Bad trace\n");
+        return 1;
+    }
+    return 0;
+}
+
+// send `file' to the server at `path' and print its answer like a
+// local search would.
+static int query(const char *path, const char *file, int m, int timeout) {
+    FILE *f = fopen(file, "r");
+    if (f == NULL) {
+        printf("Parse failed\n");
+        return 1;
+    }
+    double start = wall_time();
+    size_t n;
+    int result;
+    int err = serve_request(path, f, m, timeout, &n, &result, NULL);
+    double t = wall_time() - start;
+    fclose(f);
+    if (err != 0) {
+        printf("Request failed\n");
+        return 1;
+    }
+    printf("%s, %zu, %u, %d, %f\n", file, n, m, result, t);
+    return 0;
+}
 
 int main(int argc, char **argv) {
     int m;
+    int m_hi;
     int timeout;
     int do_dot = 0;
+    int do_range = 0;
+    int do_deepen = 0;
+    int do_portfolio = 0;
+    int do_local = 0;
+    int do_improve = 0;
+    int do_restart = 0;
+    const char *file = argv[1];
     int input_err = 0;
-    if (argc == 3) {
+    if (argc == 3 && strcmp(argv[1], "serve") == 0) {
+        return (serve(argv[2], CACHE_SIZE) == 0) ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "decode") == 0) {
+        return decode(argv[2]);
+    }
+    if (argc == 4 && strcmp(argv[1], "work") == 0) {
+        return (dist_work(argv[2], argv[3]) == 0) ? 0 : 1;
+    }
+    if (argc == 6 && strcmp(argv[1], "query") == 0) {
+        if ((m = atoi(argv[4])) <= 0) {
+            input_err = 1;
+        }
+        else {
+            return query(argv[2], argv[3], m, atoi(argv[5]));
+        }
+    }
+    else if (argc == 6 && strcmp(argv[1], "checkpoint") == 0) {
+        if ((m = atoi(argv[4])) <= 0) {
+            input_err = 1;
+        }
+        else {
+            return resumable(argv[2], argv[3], m, atoi(argv[5]));
+        }
+    }
+    else if (argc == 6 && strcmp(argv[1], "coordinate") == 0) {
+        if ((m = atoi(argv[4])) <= 0) {
+            input_err = 1;
+        }
+        else {
+            return coordinate(argv[2], argv[3], m, atoi(argv[5]));
+        }
+    }
+    else if (argc == 6 && strcmp(argv[1], "trace") == 0) {
+        if ((m = atoi(argv[4])) <= 0) {
+            input_err = 1;
+        }
+        else {
+            return traced(argv[2], argv[3], m, atoi(argv[5]));
+        }
+    }
+    else if (argc == 5 && (strcmp(argv[1], "deepen") == 0 ||
+                           strcmp(argv[1], "portfolio") == 0 ||
+                           strcmp(argv[1], "local") == 0 ||
+                           strcmp(argv[1], "improve") == 0 ||
+                           strcmp(argv[1], "restart") == 0)) {
+        do_deepen = strcmp(argv[1], "deepen") == 0;
+        do_portfolio = strcmp(argv[1], "portfolio") == 0;
+        do_local = strcmp(argv[1], "local") == 0;
+        do_improve = strcmp(argv[1], "improve") == 0;
+        do_restart = strcmp(argv[1], "restart") == 0;
+        if ((m = atoi(argv[3])) <= 0) {
+            input_err = 1;
+        }
+        timeout = atoi(argv[4]);
+        // the local search has no other way to stop
+        if (do_local && timeout < 0) {
+            input_err = 1;
+        }
+        file = argv[2];
+    }
+    else if (argc == 3) {
         do_dot = 1;
         if (strcmp(argv[2], "dot") != 0) {
             input_err = 1;
@@ -24,18 +247,42 @@ int main(int argc, char **argv) {
         }
         timeout = atoi(argv[3]);
     }
+    else if (argc == 5) {
+        do_range = 1;
+        if ((m = atoi(argv[2])) <= 0 || (m_hi = atoi(argv[3])) < m) {
+            input_err = 1;
+        }
+        timeout = atoi(argv[4]);
+    }
     else {
         input_err = 1;
     }
 
     if (input_err) {
         printf("Usage: %s <patterson file> m timeout\n", argv[0]);
+        printf("or: %s <patterson file> m_lo m_hi timeout\n", argv[0]);
         printf("or: %s <patterson file> \"dot\"\n", argv[0]);
+        printf("or: %s deepen <patterson file> m timeout\n", argv[0]);
+        printf("or: %s portfolio <patterson file> m timeout\n", argv[0]);
+        printf("or: %s local <patterson file> m timeout\n", argv[0]);
+        printf("or: %s improve <patterson file> m timeout\n", argv[0]);
+        printf("or: %s restart <patterson file> m timeout\n", argv[0]);
+        printf("or: %s serve <socket>\n", argv[0]);
+        printf("or: %s query <socket> <patterson file> m timeout\n",
+               argv[0]);
+        printf("or: %s checkpoint <file> <patterson file> m timeout\n",
+               argv[0]);
+        printf("or: %s trace <file> <patterson file> m timeout\n",
+               argv[0]);
+        printf("or: %s decode <trace file>\n", argv[0]);
+        printf("or: %s coordinate <port> <patterson file> m timeout\n",
+               argv[0]);
+        printf("or: %s work <host> <port>\n", argv[0]);
         return 1;
     }
 
     dag *g;
-    if (parse_patterson(argv[1], &g) != 0) {
+    if (load(file, &g) != 0) {
         printf("Parse failed\n");
         return 1;
     }
@@ -45,12 +292,61 @@ int main(int argc, char **argv) {
         return 0;
     }
 
-    clock_t start = clock();
-    int result = bbsearch(g, m, timeout);
-    clock_t end = clock();
-    double t = ((double)end - (double)start) / CLOCKS_PER_SEC;
+    if (do_range) {
+        int results[m_hi - m + 1];
+        double times[m_hi - m + 1];
+        if (bbsearch_range(g, m, m_hi, timeout, results, times) != 0) {
+            printf("Search failed\n");
+            return 1;
+        }
+        for (int i = m; i <= m_hi; i++) {
+            printf("%s, %zu, %u, %d, %f\n", file, dag_size(g) - 2, i,
+                   results[i - m], times[i - m]);
+        }
+        dag_destroy(g);
+        return 0;
+    }
 
-    // file, # nodes, m, schedule length, scheduling time
-    printf("%s, %zu, %u, %d, %f\n", argv[1], dag_size(g) - 2, m, result, t);
+    double start = search_time(do_portfolio);
+    int result;
+    unsigned found = 0;
+    if (do_portfolio) {
+        result = bbsearch_portfolio(g, m, timeout, NULL, 0);
+    }
+    else if (do_deepen) {
+        result = bbsearch_deepening(g, m, timeout);
+    }
+    else if (do_local) {
+        result = local_search(g, m, timeout, 0, 1, NULL);
+    }
+    else if (do_improve) {
+        result = bbsearch_local(g, m, timeout, &found);
+    }
+    else if (do_restart) {
+        result = bbsearch_restarts(g, m, timeout, 1);
+    }
+    else {
+        result = bbsearch(g, m, timeout);
+    }
+    double t = search_time(do_portfolio) - start;
+
+    // file, # nodes, m, schedule length, scheduling time, and the
+    // shortest schedule found even if the search timed out
+    if (do_improve) {
+        printf("%s, %zu, %u, %d, %f, %u\n", file, dag_size(g) - 2, m,
+               result, t, found);
+    }
+    else {
+        printf("%s, %zu, %u, %d, %f\n", file, dag_size(g) - 2, m, result,
+               t);
+    }
+#ifdef STATS
+    bbstats stats;
+    bbsearch_stats(&stats);
+    // nodes, pruned by quick, Fernandez, and Fujita bounds, restarts
+    fprintf(stderr, "%lu, %lu, %lu, %lu, %lu\n", stats.nodes,
+            stats.pruned[BB_TIER_QUICK], stats.pruned[BB_TIER_FERNANDEZ],
+            stats.pruned[BB_TIER_FUJITA], stats.restarts);
+#endif
     dag_destroy(g);
 }
@@ -0,0 +1,548 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bbsearch.h"
+#include "dag.h"
+#include "generate.h"
+#include "local.h"
+#include "parser.h"
+#include "schedule.h"
+
+// the most tasks an instance can have, one bit each in a mask of
+// predecessors. Every order of the tasks is tried, so far fewer are
+// practical.
+#define MAX_TASKS (64)
+
+// moves per task of the local search that is checked
+#define LOCAL_MOVES (100)
+
+// an instance to check: tasks 0 to n - 1, each after all of its
+// predecessors, which are given as a mask of the tasks before it.
+typedef struct instance {
+    size_t n;
+    unsigned m;
+    int weights[MAX_TASKS];
+    uint64_t preds[MAX_TASKS];
+} instance;
+
+// the check an instance failed, what it should have given and what it
+// gave.
+typedef struct failure {
+    const char *check;
+    long expected;
+    long got;
+} failure;
+
+static int run_bbsearch(dag *g, unsigned m) {
+    return bbsearch(g, m, -1);
+}
+
+static int run_weight(dag *g, unsigned m) {
+    return bbsearch_tiebreak(g, m, -1, bb_tiebreak_weight);
+}
+
+static int run_succs(dag *g, unsigned m) {
+    return bbsearch_tiebreak(g, m, -1, bb_tiebreak_succs);
+}
+
+static int run_deepening(dag *g, unsigned m) {
+    return bbsearch_deepening(g, m, -1);
+}
+
+static int run_local(dag *g, unsigned m) {
+    return bbsearch_local(g, m, -1, NULL);
+}
+
+static int run_restarts(dag *g, unsigned m) {
+    return bbsearch_restarts(g, m, -1, dag_hash(g));
+}
+
+static int run_portfolio(dag *g, unsigned m) {
+    return bbsearch_portfolio(g, m, -1, NULL, 0);
+}
+
+// the shortest schedule over the subproblems of each first task, as a
+// distributed search splits it.
+static int run_split(dag *g, unsigned m) {
+    unsigned source = dag_source(g);
+    size_t nfirst = dag_nsuccs(g, source);
+    unsigned first[nfirst];
+    dag_succs(g, source, first);
+    int best = INT_MAX;
+    for (size_t i = 0; i < nfirst; i++) {
+        bbjob *job = bbsearch_start_prefix(g, m, -1, first + i, 1, UINT_MAX);
+        if (job == NULL) {
+            return -1;
+        }
+        int result = bbsearch_join(job);
+        if (result < 0) {
+            return result;
+        }
+        best = (result < best) ? result : best;
+    }
+    return best;
+}
+
+// the searches that must find exactly the shortest schedule
+static const struct {
+    const char *name;
+    int (*run)(dag *g, unsigned m);
+} engines[] = {
+    {"bbsearch", run_bbsearch},
+    {"tiebreak weight", run_weight},
+    {"tiebreak succs", run_succs},
+    {"deepening", run_deepening},
+    {"local", run_local},
+    {"restarts", run_restarts},
+    {"portfolio", run_portfolio},
+    {"split", run_split},
+};
+
+// fills `in' with the tasks of `g', which must have been built from
+// tasks added with dag_vertex after their predecessors.
+static int from_dag(dag *g, unsigned m, instance *in) {
+    size_t size = dag_size(g);
+    if (size < 2 || size - 2 > MAX_TASKS || dag_source(g) != 0 ||
+        dag_sink(g) != size - 1) {
+        return -1;
+    }
+    in->n = size - 2;
+    in->m = m;
+    for (size_t i = 0; i < in->n; i++) {
+        unsigned id = i + 1;
+        in->weights[i] = dag_weight(g, id);
+        in->preds[i] = 0;
+        size_t npreds = dag_npreds(g, id);
+        unsigned preds[npreds];
+        dag_preds(g, id, preds);
+        for (size_t k = 0; k < npreds; k++) {
+            if (preds[k] != 0) {
+                in->preds[i] |= (uint64_t) 1 << (preds[k] - 1);
+            }
+        }
+    }
+    return 0;
+}
+
+// returns a new built dag of the tasks in `in', or NULL on failure.
+static dag *to_dag(const instance *in) {
+    dag *g = dag_create();
+    if (g == NULL) {
+        return NULL;
+    }
+    unsigned ids[MAX_TASKS];
+    for (size_t i = 0; i < in->n; i++) {
+        unsigned deps[MAX_TASKS];
+        size_t ndeps = 0;
+        for (size_t k = 0; k < i; k++) {
+            if (in->preds[i] & ((uint64_t) 1 << k)) {
+                deps[ndeps++] = ids[k];
+            }
+        }
+        ids[i] = dag_vertex(g, in->weights[i], ndeps, deps);
+        if (ids[i] == (unsigned) -1) {
+            dag_destroy(g);
+            return NULL;
+        }
+    }
+    if (dag_build(g) != 0) {
+        dag_destroy(g);
+        return NULL;
+    }
+    return g;
+}
+
+// checks the lower bounds of the partial schedule `s' against
+// `best', the makespan of its shortest completion.
+static int check_bounds(schedule *s, unsigned best, failure *f) {
+    if (schedule_build(s, 0) != 0) {
+        return -1;
+    }
+    unsigned quick = schedule_quick_bound(s);
+    if (quick > best) {
+        *f = (failure) {"quick bound", best, quick};
+        return 0;
+    }
+#ifdef FUJITA
+    int fb = schedule_fernandez_bound(s);
+    if (fb > (long) best) {
+        *f = (failure) {"fernandez bound", best, fb};
+        return 0;
+    }
+    // a completion of length `best' exists, so it cannot take more
+    // machines than there are to finish by then
+    if (schedule_build(s, best) != 0) {
+        return -1;
+    }
+    int mb = schedule_machine_bound(s);
+    if (mb > (long) schedule_m(s)) {
+        *f = (failure) {"machine bound", schedule_m(s), mb};
+        return 0;
+    }
+#endif // FUJITA
+    return 0;
+}
+
+// returns the makespan of the tasks of `in' placed one after the other
+// in `order', without going through schedule_add. Each task goes on
+// the machine that is free first, and starts once that machine and all
+// of its predecessors are done. If `follow' is set and a predecessor
+// ends after the machine is free, the task goes on the machine of the
+// latest such predecessor instead, as long as nothing was placed after
+// the predecessor there. Either way the shortest makespan over all
+// orders is the optimum.
+static long decode(const instance *in, const unsigned *order, int follow) {
+    long machine_ends[in->m];
+    long ends[MAX_TASKS];
+    unsigned machines[MAX_TASKS];
+    for (unsigned k = 0; k < in->m; k++) {
+        machine_ends[k] = 0;
+    }
+    long length = 0;
+    for (size_t i = 0; i < in->n; i++) {
+        unsigned t = order[i];
+        unsigned machine = 0;
+        for (unsigned k = 1; k < in->m; k++) {
+            machine = (machine_ends[k] < machine_ends[machine]) ? k : machine;
+        }
+        long start = machine_ends[machine];
+        long ready = 0;
+        unsigned latest = 0;
+        for (unsigned p = 0; p < t; p++) {
+            if ((in->preds[t] & ((uint64_t) 1 << p)) && ends[p] > ready) {
+                ready = ends[p];
+                latest = p;
+            }
+        }
+        if (ready > start) {
+            if (follow && machine_ends[machines[latest]] <= ready) {
+                machine = machines[latest];
+            }
+            start = ready;
+        }
+        ends[t] = start + in->weights[t];
+        machines[t] = machine;
+        machine_ends[machine] = ends[t];
+        length = (ends[t] > length) ? ends[t] : length;
+    }
+    return length;
+}
+
+// returns the makespan of the shortest completion of `s', a schedule
+// of the tasks of `in', trying every order of the tasks left. Checks
+// the lower bounds at every partial schedule on the way, and the
+// length of every complete schedule against decode. Lowers `earliest'
+// to the shortest makespan decode gives without following
+// predecessors. Stops as soon as a check fails. Returns -1 on error.
+static long explore(schedule *s, const instance *in, long *earliest,
+                    failure *f) {
+    dag *g = schedule_dag(s);
+    size_t size = dag_size(g);
+    if (schedule_size(s) == size) {
+        // the tasks of `in' are the dag's vertices but the source and
+        // sink, which take no time
+        unsigned order[MAX_TASKS];
+        size_t n = 0;
+        for (size_t i = 0; i < size; i++) {
+            unsigned v = schedule_get(s, i);
+            if (v != dag_source(g) && v != dag_sink(g)) {
+                order[n++] = v - 1;
+            }
+        }
+        long len = decode(in, order, 1);
+        if ((long) schedule_length(s) != len) {
+            *f = (failure) {"schedule length", len, schedule_length(s)};
+        }
+        long plain = decode(in, order, 0);
+        *earliest = (plain < *earliest) ? plain : *earliest;
+        return len;
+    }
+    long best = LONG_MAX;
+    for (unsigned v = 0; v < size && f->check == NULL; v++) {
+        if (schedule_contains(s, v) || schedule_preds_left(s, v) != 0) {
+            continue;
+        }
+        if (schedule_add(s, v) != 0) {
+            return -1;
+        }
+        long len = explore(s, in, earliest, f);
+        schedule_pop(s);
+        if (len < 0) {
+            return -1;
+        }
+        best = (len < best) ? len : best;
+    }
+    if (f->check == NULL && check_bounds(s, best, f) != 0) {
+        return -1;
+    }
+    return best;
+}
+
+// checks every search and bound on `in'. Returns 1 and describes the
+// first check that failed in `f', 0 if all of them passed, and -1 on
+// error.
+static int check(const instance *in, failure *f) {
+    int result = -1;
+    *f = (failure) {NULL, 0, 0};
+    dag *g = to_dag(in);
+    if (g == NULL) {
+        goto err0;
+    }
+    schedule *s = schedule_create(g, in->m);
+    if (s == NULL || schedule_add(s, dag_source(g)) != 0) {
+        goto err1;
+    }
+    long opt = LONG_MAX;
+    long best = explore(s, in, &opt, f);
+    if (best < 0) {
+        goto err1;
+    }
+    if (f->check == NULL && best != opt) {
+        *f = (failure) {"schedule_add optimum", opt, best};
+    }
+    if (f->check != NULL) {
+        result = 1;
+        goto err1;
+    }
+    for (size_t i = 0; i < sizeof(engines) / sizeof(*engines); i++) {
+        int got = engines[i].run(g, in->m);
+        if (got == -1) {
+            goto err1;
+        }
+        if (got != opt) {
+            *f = (failure) {engines[i].name, opt, got};
+            result = 1;
+            goto err1;
+        }
+    }
+    int got = local_search(g, in->m, -1, LOCAL_MOVES * dag_size(g),
+                           dag_hash(g), NULL);
+    if (got == -1) {
+        goto err1;
+    }
+    if (got < opt) {
+        *f = (failure) {"local search", opt, got};
+        result = 1;
+        goto err1;
+    }
+    result = 0;
+
+ err1:
+    if (s != NULL) {
+        schedule_destroy(s);
+    }
+    dag_destroy(g);
+ err0:
+    return result;
+}
+
+// stores in `out' the instance `in' without task `i'. Its predecessors
+// become predecessors of its successors.
+static void remove_task(const instance *in, size_t i, instance *out) {
+    uint64_t below = ((uint64_t) 1 << i) - 1;
+    out->n = in->n - 1;
+    out->m = in->m;
+    for (size_t k = 0, j = 0; k < in->n; k++) {
+        if (k == i) {
+            continue;
+        }
+        uint64_t preds = in->preds[k];
+        if (preds & ((uint64_t) 1 << i)) {
+            preds |= in->preds[i];
+        }
+        out->weights[j] = in->weights[k];
+        out->preds[j] = (preds & below) | ((preds >> 1) & ~below);
+        j++;
+    }
+}
+
+// replaces `in' with the smaller instance `cand' if it fails the same
+// check. Returns 1 if it does, 0 if not and -1 on error.
+static int try_smaller(instance *in, failure *f, const instance *cand) {
+    failure cf;
+    int err = check(cand, &cf);
+    if (err <= 0) {
+        return err;
+    }
+    if (strcmp(cf.check, f->check) != 0) {
+        return 0;
+    }
+    *in = *cand;
+    *f = cf;
+    return 1;
+}
+
+// shrinks the failing instance `in' by taking away machines, tasks and
+// edges and lowering weights, one at a time, for as long as it keeps
+// failing the check in `f'. Returns 0 on success and -1 on error.
+static int shrink(instance *in, failure *f) {
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        instance cand = *in;
+        if (in->m > 1) {
+            cand.m = in->m - 1;
+            int err = try_smaller(in, f, &cand);
+            if (err < 0) {
+                return -1;
+            }
+            changed |= err;
+        }
+        for (size_t i = in->n; i-- > 0 && in->n > 1;) {
+            if (i >= in->n) {
+                continue;
+            }
+            remove_task(in, i, &cand);
+            int err = try_smaller(in, f, &cand);
+            if (err < 0) {
+                return -1;
+            }
+            changed |= err;
+        }
+        for (size_t i = 0; i < in->n; i++) {
+            for (size_t k = 0; k < i; k++) {
+                if (!(in->preds[i] & ((uint64_t) 1 << k))) {
+                    continue;
+                }
+                cand = *in;
+                cand.preds[i] &= ~((uint64_t) 1 << k);
+                int err = try_smaller(in, f, &cand);
+                if (err < 0) {
+                    return -1;
+                }
+                changed |= err;
+            }
+        }
+        for (size_t i = 0; i < in->n; i++) {
+            int tries[] = {1, in->weights[i] / 2, in->weights[i] - 1};
+            for (size_t t = 0; t < sizeof(tries) / sizeof(*tries); t++) {
+                if (tries[t] < 1 || tries[t] >= in->weights[i]) {
+                    continue;
+                }
+                cand = *in;
+                cand.weights[i] = tries[t];
+                int err = try_smaller(in, f, &cand);
+                if (err < 0) {
+                    return -1;
+                }
+                changed |= err;
+            }
+        }
+    }
+    return 0;
+}
+
+// writes the tasks of `in' to `path' in the Patterson format.
+static int write_instance(const instance *in, const char *path) {
+    dag *g = to_dag(in);
+    if (g == NULL) {
+        return -1;
+    }
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        dag_destroy(g);
+        return -1;
+    }
+    int err = write_patterson(g, f);
+    err |= fclose(f);
+    dag_destroy(g);
+    return (err != 0) ? -1 : 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-i instances] [-n max tasks] [-m max machines]\n"
+           "       [-s seed] [-o output prefix]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    unsigned long instances = 1000;
+    size_t max_n = 8;
+    unsigned max_m = 4;
+    uint64_t seed = 1;
+    const char *prefix = "fuzz";
+    int input_err = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:m:s:o:")) != -1) {
+        switch (opt) {
+        case 'i':
+            instances = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            max_n = strtoul(optarg, NULL, 10);
+            break;
+        case 'm':
+            max_m = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'o':
+            prefix = optarg;
+            break;
+        default:
+            input_err = 1;
+        }
+    }
+    if (input_err || optind != argc || max_n == 0 || max_n > MAX_TASKS ||
+        max_m == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    gen_rng rng = {.state = seed};
+    unsigned long failures = 0;
+    for (unsigned long i = 0; i < instances; i++) {
+        gen_params p = {
+            .shape = gen_range(&rng, GEN_LAYERED, GEN_CHAIN),
+            .n = gen_range(&rng, 1, max_n),
+            .density = gen_uniform(&rng),
+            .width = gen_range(&rng, 1, 4),
+            .weights = gen_range(&rng, GEN_UNIFORM, GEN_EXPONENTIAL),
+            .w_min = 1,
+            .w_max = gen_range(&rng, 1, 20),
+            .seed = gen_next(&rng),
+        };
+        unsigned m = gen_range(&rng, 1, max_m);
+        dag *g = generate(&p);
+        if (g == NULL) {
+            printf("Generation failed\n");
+            return 1;
+        }
+        // some shapes round the number of tasks up
+        instance in;
+        int err = (dag_size(g) - 2 > max_n) ? 1 : from_dag(g, m, &in);
+        dag_destroy(g);
+        if (err > 0) {
+            continue;
+        }
+        failure f;
+        if (err != 0 || (err = check(&in, &f)) < 0) {
+            printf("Check failed\n");
+            return 1;
+        }
+        if (err == 0) {
+            continue;
+        }
+        failures++;
+        if (shrink(&in, &f) != 0) {
+            printf("Shrinking failed\n");
+            return 1;
+        }
+        char path[strlen(prefix) + 64];
+        snprintf(path, sizeof(path), "%s-%lu-m%u.rcp", prefix, i, in.m);
+        if (write_instance(&in, path) != 0) {
+            printf("Cannot write %s\n", path);
+            return 1;
+        }
+        printf("%s, %s, %zu, %u, %ld, %ld\n", path, f.check, in.n, in.m,
+               f.expected, f.got);
+    }
+    printf("%lu instances, %lu failures\n", instances, failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -1,22 +1,264 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <time.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-#include "binheap.h"
 #include "bitmap.h"
 #include "dag.h"
+#include "generate.h"
+#include "local.h"
 #include "schedule.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "vector.h"
 #include "bbsearch.h"
 
-static int do_timeout;
-static clock_t end_time;
+// the clock is only read every CHECK_INTERVAL nodes, which must be a
+// power of two, unless the dag has at least SLOW_TASKS tasks. Then a
+// single node can take seconds, so it is read at every node and every
+// probe of fujita_bound.
+#define CHECK_INTERVAL (64)
+#define SLOW_TASKS (256)
+
+// nodes searched before the first restart of bbsearch_restarts, and how
+// many times as many each later search is allowed. Smaller limits
+// repeat too much work on DAGs that need a long search anyway.
+#define RESTART_UNIT (16384)
+#define RESTART_GROWTH (2)
+
+// moves per task the local search of bbsearch_local makes
+#define LOCAL_MOVES (100)
+
+// the part of its timeout bbsearch_local leaves to the local search
+#define LOCAL_SHARE (0.1)
+
+#define CHECKPOINT_MAGIC (0x4b434242) // "BBCK"
+#define CHECKPOINT_VERSION (1)
+
+// everything one search needs, so that several can run at once.
+typedef struct search_state {
+    schedule *s;
+    bitmap *ready_set;
+
+    // tasks in the order they are branched on, and the position of
+    // each task in that order. The ready set is indexed by position.
+    unsigned *branch_order;
+    unsigned *branch_rank;
+
+    int do_timeout;
+    double end_time;
+    // whether to read the clock at every node, see SLOW_TASKS
+    int slow;
+    bbstats stats;
+
+    // no schedule can be shorter than `floor_bound', so the search
+    // stops as soon as it finds one that long. `incumbent' is the
+    // shortest makespan known so far, including one passed in by the
+    // caller.
+    unsigned floor_bound;
+    atomic_uint incumbent;
+    // if not 0, only schedules of at most this length are looked for
+    unsigned target;
+    // if not 0, the search gives up once `stats.nodes' reaches this
+    unsigned long node_limit;
+    // whether to go on to Fujita's bound after the Fernandez bound
+    int use_fujita;
+    // if not 0, tasks the tiebreak cannot tell apart are branched on in
+    // an order drawn from this seed instead of by id
+    uint64_t seed;
+
+    // if not NULL, the shortest makespan found by any of several
+    // searches of the same dag, which all prune against it, and a flag
+    // that stops them all
+    atomic_uint *shared;
+    atomic_int *stop;
+
+#if defined(FUJITA) && defined(PROBES)
+    // scratch space for the horizons fujita_bound tries at once,
+    // created the first time they are needed
+    schedule_probe *probes[PROBES];
+#endif
+
+    // if not NULL, every node is recorded here
+    trace_buffer *trace;
+
+    // read by other threads while the search runs
+    atomic_ulong nodes;
+    atomic_int cancelled;
+
+    // if not NULL, the ranks branched on from the root down to the
+    // node where the search stopped are pushed here, deepest first
+    idx_vec *path;
+    // tasks scheduled after the source before the search starts, so
+    // that only the schedules starting with them are searched
+    const unsigned *prefix;
+    size_t prefix_len;
+    // ranks to branch on first from the root down when resuming, and
+    // how many of them have been used
+    const unsigned *resume;
+    size_t resume_len;
+    size_t resume_at;
+} search_state;
+
+struct bbjob {
+    dag *g;
+    unsigned m;
+    int timeout;
+    unsigned upper;
+    unsigned *prefix;
+    // the shortest makespan known outside the job
+    atomic_uint bound;
+    search_state st;
+
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    int done;
+    int result;
+};
+
+// counters from the last search finished or joined on this thread
+static _Thread_local bbstats last_stats;
+
+// set from signal handlers, so it stops every search
+static atomic_int interrupted;
+
+// if not NULL, the file every search records its nodes in
+static _Atomic(trace *) tracing;
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static threadpool *pool;
+
+// CPU time used by the calling thread, so that searches running side
+// by side do not use up each other's timeouts.
+static double thread_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the time reported for a search. The probe threads of PROBES work
+// for the searching thread while it waits, so then it is the wall
+// clock.
+static double report_time(void) {
+#ifdef PROBES
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    return thread_time();
+#endif // PROBES
+}
+
+long bb_tiebreak_index(dag *g, unsigned id) {
+    // renumbering the dag does not change the search
+    return -(long) dag_input_id(g, id);
+}
+
+long bb_tiebreak_weight(dag *g, unsigned id) {
+    return dag_weight(g, id);
+}
+
+long bb_tiebreak_succs(dag *g, unsigned id) {
+    return dag_nsuccs(g, id);
+}
+
+typedef struct branch_key {
+    unsigned id;
+    int level;
+    long key;
+    uint64_t salt;
+} branch_key;
+
+static int branch_key_cmp(const void *a, const void *b) {
+    const branch_key *ka = a;
+    const branch_key *kb = b;
+    if (ka->level != kb->level) {
+        return (ka->level > kb->level) ? -1 : 1;
+    }
+    if (ka->key != kb->key) {
+        return (ka->key > kb->key) ? -1 : 1;
+    }
+    if (ka->salt != kb->salt) {
+        return (ka->salt < kb->salt) ? -1 : 1;
+    }
+    return (ka->id < kb->id) ? -1 : (ka->id > kb->id);
+}
+
+// sort the tasks by decreasing level, then by decreasing key, then in
+// an order drawn from the seed.
+static int branch_order_create(search_state *st, dag *g,
+                               bb_tiebreak tiebreak) {
+    size_t n = dag_size(g);
+    branch_key *keys = malloc(n * sizeof(*keys));
+    st->branch_order = malloc(n * sizeof(*st->branch_order));
+    st->branch_rank = malloc(n * sizeof(*st->branch_rank));
+    if (keys == NULL || st->branch_order == NULL || st->branch_rank == NULL) {
+        free(keys);
+        free(st->branch_order);
+        free(st->branch_rank);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = (branch_key) {
+            .id = i,
+            .level = dag_level(g, i),
+            .key = tiebreak(g, i),
+            .salt = 0,
+        };
+        if (st->seed != 0) {
+            gen_rng rng = {.state = st->seed ^ i};
+            keys[i].salt = gen_next(&rng);
+        }
+    }
+    qsort(keys, n, sizeof(*keys), branch_key_cmp);
+    for (size_t r = 0; r < n; r++) {
+        st->branch_order[r] = keys[r].id;
+        st->branch_rank[keys[r].id] = r;
+    }
+    free(keys);
+    return 0;
+}
+
+static void branch_order_destroy(search_state *st) {
+    free(st->branch_order);
+    free(st->branch_rank);
+}
 
-int fujita_bound(schedule *s) {
+// returns -3 once the search is cancelled, -2 once it is interrupted
+// or, if `read_clock' is set, out of time, and 0 otherwise.
+static int bb_stopped(search_state *st, int read_clock) {
+    if (atomic_load_explicit(&st->cancelled, memory_order_relaxed) ||
+        (st->stop != NULL &&
+         atomic_load_explicit(st->stop, memory_order_relaxed))) {
+        return -3;
+    }
+    if (atomic_load_explicit(&interrupted, memory_order_relaxed) ||
+        (read_clock && st->do_timeout && thread_time() >= st->end_time)) {
+        return -2;
+    }
+    return 0;
+}
+
+#ifdef FUJITA
+// returns the bound, or what bb_stopped returns if the search `st' is
+// stopped between two probes. `st' may be NULL to never stop.
+static int fujita_bound(schedule *s, search_state *st) {
     dag *g = schedule_dag(s);
     unsigned delta = 1;
+    int stopped;
     while (1) {
         /* printf("loop1\n"); */
+        if (st != NULL && (stopped = bb_stopped(st, st->slow)) != 0) {
+            return stopped;
+        }
         schedule_build(s, dag_level(g, dag_source(g)) + delta);
         int min_m = schedule_machine_bound(s);
         /* printf("delta: %d, min_m: %d, m: %d\n", delta, min_m, schedule_m(s)); */
@@ -26,7 +268,10 @@ int fujita_bound(schedule *s) {
         delta = delta * 2;
         assert(delta != 0);
     }
-    int low_time = dag_level(g, dag_source(g)) + delta / 2;
+    // the critical path length itself has not been tried yet if the
+    // first probe succeeded
+    int low_time = (delta == 1) ? dag_level(g, dag_source(g)) - 1 :
+        dag_level(g, dag_source(g)) + delta / 2;
     int high_time = dag_level(g, dag_source(g)) + delta;
     int best_time = high_time;
     while (1) {
@@ -34,6 +279,9 @@ int fujita_bound(schedule *s) {
         if (cur_time == low_time) {
             break;
         }
+        if (st != NULL && (stopped = bb_stopped(st, st->slow)) != 0) {
+            return stopped;
+        }
         schedule_build(s, cur_time);
         int min_m = schedule_machine_bound(s);
         if (min_m <= schedule_m(s)) {
@@ -47,120 +295,1182 @@ int fujita_bound(schedule *s) {
     return best_time;
 }
 
-int bb(schedule *s, bitmap *ready_set, unsigned best_soln) {
-    assert(s != NULL);
-    if (do_timeout && clock() >= end_time) {
-        return -2;
+#ifdef PROBES
+// fujita_bound tries PROBES horizons at once, but only while at least
+// this many tasks are left, since each try is too quick to hand out
+// otherwise.
+#define PROBE_MIN_TASKS (32)
+
+// the calling thread runs one probe of each round itself
+static pthread_once_t probe_pool_once = PTHREAD_ONCE_INIT;
+static threadpool *probe_pool;
+
+static void probe_pool_create(void) {
+    probe_pool = threadpool_create((PROBES > 1) ? PROBES - 1 : 1);
+}
+
+// one round of probes of the same schedule at different horizons.
+typedef struct probe_round {
+    schedule *s;
+    schedule_probe **probes;
+    size_t count;
+    unsigned times[PROBES];
+    int machines[PROBES];
+
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    size_t left;
+} probe_round;
+
+typedef struct probe_task {
+    probe_round *round;
+    size_t i;
+} probe_task;
+
+static void probe_run(void *arg) {
+    probe_task *task = arg;
+    probe_round *round = task->round;
+    round->machines[task->i] =
+        schedule_probe_machines(round->s, round->probes[task->i],
+                                round->times[task->i]);
+    pthread_mutex_lock(&round->lock);
+    if (--round->left == 0) {
+        pthread_cond_signal(&round->finished);
     }
+    pthread_mutex_unlock(&round->lock);
+}
+
+// fills in the machine bound at each of the round's horizons.
+static void probe_round_run(probe_round *round) {
+    probe_task tasks[PROBES];
+    round->left = round->count;
+    for (size_t i = 0; i < round->count; i++) {
+        tasks[i] = (probe_task) {.round = round, .i = i};
+        if (i == 0 || threadpool_submit(probe_pool, probe_run,
+                                        &tasks[i]) != 0) {
+            probe_run(&tasks[i]);
+        }
+    }
+    pthread_mutex_lock(&round->lock);
+    while (round->left != 0) {
+        pthread_cond_wait(&round->finished, &round->lock);
+    }
+    pthread_mutex_unlock(&round->lock);
+}
+
+static void probes_destroy(search_state *st) {
+    for (size_t i = 0; i < PROBES; i++) {
+        if (st->probes[i] != NULL) {
+            schedule_probe_destroy(st->probes[i]);
+            st->probes[i] = NULL;
+        }
+    }
+}
+
+// same as fujita_bound, with every round of probes run at once. The
+// doubling search tries the next PROBES horizons and keeps the first
+// that fits. The binary search tries the midpoints of the next levels
+// of its own decision tree, then follows the path the serial search
+// would have taken, so the bound is exactly the same. Returns -1 on
+// error, and what bb_stopped returns if the search is stopped between
+// two rounds.
+static int fujita_bound_parallel(search_state *st) {
+    schedule *s = st->s;
     dag *g = schedule_dag(s);
-    if (schedule_build(s, 0) != 0) {
+    pthread_once(&probe_pool_once, probe_pool_create);
+    if (probe_pool == NULL || schedule_probe_ready(s) != 0) {
         return -1;
     }
+    for (size_t i = 0; i < PROBES; i++) {
+        if (st->probes[i] == NULL) {
+            st->probes[i] = schedule_probe_create(s);
+            if (st->probes[i] == NULL) {
+                return -1;
+            }
+        }
+    }
+    probe_round round = {.s = s, .probes = st->probes};
+    pthread_mutex_init(&round.lock, NULL);
+    pthread_cond_init(&round.finished, NULL);
+    int m = schedule_m(s);
+    unsigned crit = dag_level(g, dag_source(g));
+
+    unsigned delta = 1;
+    int stopped = 0;
+    for (int found = 0; !found;) {
+        if ((stopped = bb_stopped(st, st->slow)) != 0) {
+            goto err;
+        }
+        round.count = PROBES;
+        for (size_t i = 0; i < PROBES; i++) {
+            assert(delta << i != 0);
+            round.times[i] = crit + (delta << i);
+        }
+        probe_round_run(&round);
+        for (size_t i = 0; i < PROBES && !found; i++) {
+            found = round.machines[i] <= m;
+            delta = found ? delta << i : delta;
+        }
+        if (!found) {
+            delta = delta << PROBES;
+            assert(delta != 0);
+        }
+    }
+
+    // the levels of the decision tree tried in one round, with node j
+    // in heap order: its left child is taken when its midpoint fits
+    size_t nnodes = 1;
+    while (2 * nnodes + 1 <= PROBES) {
+        nnodes = 2 * nnodes + 1;
+    }
+    int low_time = (delta == 1) ? crit - 1 : crit + delta / 2;
+    int high_time = crit + delta;
+    int best_time = high_time;
+    while (1) {
+        int lows[PROBES], highs[PROBES], slot[PROBES];
+        lows[0] = low_time;
+        highs[0] = high_time;
+        round.count = 0;
+        for (size_t j = 0; j < nnodes; j++) {
+            slot[j] = -1;
+            if (j > 0 && slot[(j - 1) / 2] < 0) {
+                continue;
+            }
+            int cur_time = (highs[j] - lows[j]) / 2 + lows[j];
+            if (cur_time == lows[j]) {
+                continue;
+            }
+            slot[j] = round.count;
+            round.times[round.count++] = cur_time;
+            if (2 * j + 2 < nnodes) {
+                lows[2 * j + 1] = lows[j];
+                highs[2 * j + 1] = cur_time;
+                lows[2 * j + 2] = cur_time;
+                highs[2 * j + 2] = highs[j];
+            }
+        }
+        if (round.count == 0) {
+            break;
+        }
+        if ((stopped = bb_stopped(st, st->slow)) != 0) {
+            goto err;
+        }
+        probe_round_run(&round);
+        size_t j = 0;
+        while (j < nnodes && slot[j] >= 0) {
+            int cur_time = round.times[slot[j]];
+            if (round.machines[slot[j]] <= m) {
+                high_time = cur_time;
+                best_time = (best_time < cur_time) ? best_time : cur_time;
+                j = 2 * j + 1;
+            }
+            else {
+                low_time = cur_time;
+                j = 2 * j + 2;
+            }
+        }
+    }
+    pthread_cond_destroy(&round.finished);
+    pthread_mutex_destroy(&round.lock);
+    return best_time;
+
+err:
+    pthread_cond_destroy(&round.finished);
+    pthread_mutex_destroy(&round.lock);
+    return stopped;
+}
+#endif // PROBES
+#endif // FUJITA
+
+// lowers `a' to `val' unless it is already lower.
+static void lower_to(atomic_uint *a, unsigned val) {
+    unsigned cur = atomic_load_explicit(a, memory_order_relaxed);
+    while (val < cur &&
+           !atomic_compare_exchange_weak_explicit(a, &cur, val,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed));
+}
+
+// stops the search at a node once it is cancelled, interrupted, out
+// of time or out of nodes. Returns 0 to go on, and otherwise what the
+// search should return, which is -4 for running out of nodes.
+static int bb_check(search_state *st) {
+    atomic_store_explicit(&st->nodes, st->stats.nodes, memory_order_relaxed);
+    int result = bb_stopped(st, st->slow ||
+                            (st->stats.nodes & (CHECK_INTERVAL - 1)) == 0);
+    if (result != 0) {
+        return result;
+    }
+    if (st->node_limit != 0 && st->stats.nodes >= st->node_limit) {
+        return -4;
+    }
+    return 0;
+}
+
+// records how the node was settled, and the largest bound tried, if
+// the search is traced.
+static void bb_trace(search_state *st, enum trace_reason reason,
+                     unsigned bound) {
+    if (st->trace != NULL) {
+        size_t depth = schedule_size(st->s);
+        trace_event(st->trace, TRACE_NODE, depth,
+                    schedule_get(st->s, depth - 1), reason, bound);
+    }
+}
+
+// counts the node and tries to settle it without branching. Returns 1
+// and sets `result' if the schedule is complete or a bound prunes it,
+// and 0 if the node has to be branched on. Lowers `best' to any
+// shorter makespan found by other searches sharing the incumbent. A
+// `resumed' node is on the path of a checkpoint and was counted before
+// the search stopped, and a node the search stops in is not counted.
+static int bb_bound(search_state *st, unsigned *best, int *result,
+                    int resumed) {
+    schedule *s = st->s;
+    dag *g = schedule_dag(s);
+    st->stats.nodes += !resumed;
+    if (st->shared != NULL) {
+        unsigned known = atomic_load_explicit(st->shared,
+                                              memory_order_relaxed);
+        *best = (known < *best) ? known : *best;
+    }
+    unsigned best_soln = *best;
+    if (schedule_build(s, 0) != 0) {
+        *result = -1;
+        return 1;
+    }
     if (schedule_size(s) == dag_size(g)) {
         unsigned sched_len = schedule_length(s);
-        return (best_soln < sched_len) ? best_soln : sched_len;
+        lower_to(&st->incumbent, sched_len);
+        if (st->shared != NULL) {
+            lower_to(st->shared, sched_len);
+        }
+        bb_trace(st, TRACE_COMPLETE, sched_len);
+        if (st->trace != NULL && sched_len < best_soln) {
+            trace_event(st->trace, TRACE_INCUMBENT, dag_size(g),
+                        schedule_get(s, dag_size(g) - 1), TRACE_COMPLETE,
+                        sched_len);
+        }
+        *result = (best_soln < sched_len) ? best_soln : sched_len;
+        return 1;
     }
+    *result = best_soln;
+    unsigned bound = 0;
 #ifdef FUJITA
-#ifdef FB
+    bound = schedule_quick_bound(s);
+    if (bound >= best_soln) {
+        st->stats.pruned[BB_TIER_QUICK]++;
+        bb_trace(st, TRACE_QUICK, bound);
+        return 1;
+    }
     unsigned fb = schedule_fernandez_bound(s);
+    bound = (fb > bound) ? fb : bound;
     if (fb >= best_soln) {
-        return best_soln;
+        st->stats.pruned[BB_TIER_FERNANDEZ]++;
+        bb_trace(st, TRACE_FERNANDEZ, bound);
+        return 1;
+    }
+#ifndef FB
+    // when looking for a schedule of length `target', one probe at
+    // that horizon decides whether the node can finish in time
+    int mb = 0;
+    if (st->use_fujita && st->target != 0) {
+        schedule_build(s, st->target);
+        mb = (schedule_machine_bound(s) <= (int) schedule_m(s)) ?
+            st->target : st->target + 1;
+    }
+    else if (st->use_fujita) {
+#ifdef PROBES
+        if (dag_size(g) - schedule_size(s) >= PROBE_MIN_TASKS) {
+            mb = fujita_bound_parallel(st);
+        }
+        else {
+            mb = fujita_bound(s, st);
+        }
+#else
+        mb = fujita_bound(s, st);
+#endif // PROBES
+        if (mb < 0) {
+            st->stats.nodes -= !resumed;
+            *result = mb;
+            return 1;
+        }
     }
-#else // no FB
-    unsigned mb = fujita_bound(s);
-    if (mb >= best_soln) {
-        return best_soln;
+    bound = ((unsigned) mb > bound) ? (unsigned) mb : bound;
+    if ((unsigned) mb >= best_soln) {
+        st->stats.pruned[BB_TIER_FUJITA]++;
+        bb_trace(st, TRACE_FUJITA, bound);
+        return 1;
     }
 #endif // FB
 #endif // FUJITA
-    binheap *sorter = binheap_create();
-    if (sorter == NULL) {
-        return -1;
+    bb_trace(st, TRACE_BRANCHED, bound);
+    return 0;
+}
+
+static int bb(search_state *st, unsigned best_soln) {
+    schedule *s = st->s;
+    bitmap *ready_set = st->ready_set;
+    assert(s != NULL);
+    int result = bb_check(st);
+    if (result != 0) {
+        return result;
     }
-    for (size_t i = 0; i < dag_size(g); i++) {
-        if (bitmap_get(ready_set, i) == 1) {
-            if (binheap_put(sorter, i, dag_level(g, i)) != 0) {
-                binheap_destroy(sorter);
-                return -1;
-            }
+    // the nodes on the path being resumed are entered one after the
+    // other, each starting with the branch it had stopped in
+    int start = -1;
+    if (st->resume_at < st->resume_len) {
+        start = st->resume[st->resume_at++];
+        if (bitmap_get(ready_set, start) != 1) {
+            return -1;
         }
     }
-    idx_vec new_ready;
-    idx_vec_init(&new_ready, 0);
-    while (binheap_size(sorter) > 0) {
-        unsigned new_idx = binheap_get(sorter);
+    if (bb_bound(st, &best_soln, &result, start >= 0)) {
+        return result;
+    }
+    dag *g = schedule_dag(s);
+    for (int r = (start >= 0) ? start : bitmap_next(ready_set, 0); r >= 0;
+         r = bitmap_next(ready_set, r + 1)) {
+        unsigned new_idx = st->branch_order[r];
         schedule_add(s, new_idx);
 
+        // successors whose last predecessor was just scheduled become
+        // ready until `new_idx' is removed again
         size_t nsuccs = dag_nsuccs(g, new_idx);
         unsigned succs[nsuccs];
         dag_succs(g, new_idx, succs);
         for (size_t i = 0; i < nsuccs; i++) {
-            size_t npreds = dag_npreds(g, succs[i]);
-            unsigned preds[npreds];
-            dag_preds(g, succs[i], preds);
-            int all_scheduled = 1;
-            for (size_t i = 0; i < npreds; i++) {
-                if (!schedule_contains(s, preds[i])) {
-                    all_scheduled = 0;
-                    break;
-                }
-            }
-            if (all_scheduled) {
-                idx_vec_push(&new_ready, succs[i]);
-                bitmap_set(ready_set, succs[i], 1);
+            if (schedule_preds_left(s, succs[i]) == 0) {
+                bitmap_set(ready_set, st->branch_rank[succs[i]], 1);
             }
         }
 
-        bitmap_set(ready_set, new_idx, 0);
-        int soln = bb(s, ready_set, best_soln);
-        bitmap_set(ready_set, new_idx, 1);
+        bitmap_set(ready_set, r, 0);
+        int soln = bb(st, best_soln);
+        bitmap_set(ready_set, r, 1);
+        if (start >= 0) {
+            // a bound may have cut the resumed path short
+            st->resume_len = st->resume_at;
+        }
         if (soln < 0) {
-            binheap_destroy(sorter);
+            if (st->path != NULL && idx_vec_push(st->path, r) != 0) {
+                return -1;
+            }
             return soln;
         }
         best_soln = (best_soln < soln) ? best_soln : soln;
-        while (new_ready.size > 0) {
-            unsigned r;
-            idx_vec_pop(&new_ready, &r);
-            bitmap_set(ready_set, r, 0);
+        for (size_t i = 0; i < nsuccs; i++) {
+            if (schedule_preds_left(s, succs[i]) == 0) {
+                bitmap_set(ready_set, st->branch_rank[succs[i]], 0);
+            }
         }
 
         schedule_pop(s);
+        if (best_soln <= st->floor_bound) {
+            break;
+        }
     }
-    idx_vec_destroy(&new_ready);
-    binheap_destroy(sorter);
     return best_soln;
 }
 
-int bbsearch(dag *g, unsigned m, int timeout) {
+#ifndef NO_MASK_SEARCH
+static int ctz64(uint64_t x) {
+    return __builtin_ctzll(x);
+}
+
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 uint128;
+
+static int ctz128(uint128 x) {
+    uint64_t low = x;
+    return (low != 0) ? __builtin_ctzll(low) :
+        64 + __builtin_ctzll((uint64_t) (x >> 64));
+}
+#endif // __SIZEOF_INT128__
+
+// defines NAME, the same search as bb for dags that fit in one TYPE,
+// with the sets of tasks held as masks of branch ranks instead of in
+// bitmaps. The ready and scheduled sets are passed by value, so
+// nothing has to be undone after a branch. CTZ returns the lowest set
+// bit of a nonzero TYPE. NAME##_run sets up the masks and runs the
+// search from the root.
+#define DEFINE_MASK_SEARCH(NAME, TYPE, CTZ)                             \
+    static int NAME(search_state *st, const TYPE *preds,                \
+                    const TYPE *succs, TYPE ready, TYPE done,           \
+                    unsigned best_soln) {                               \
+        int result = bb_check(st);                                      \
+        if (result != 0) {                                              \
+            return result;                                              \
+        }                                                               \
+        int start = -1;                                                 \
+        if (st->resume_at < st->resume_len) {                           \
+            start = st->resume[st->resume_at++];                        \
+            if ((unsigned) start >= sizeof(TYPE) * CHAR_BIT ||          \
+                (ready & ((TYPE) 1 << start)) == 0) {                   \
+                return -1;                                              \
+            }                                                           \
+        }                                                               \
+        if (bb_bound(st, &best_soln, &result, start >= 0)) {            \
+            return result;                                              \
+        }                                                               \
+        TYPE left = ready;                                              \
+        if (start >= 0) {                                               \
+            left &= ~(((TYPE) 1 << start) - 1);                         \
+        }                                                               \
+        for (; left != 0; left &= left - 1) {                           \
+            int r = CTZ(left);                                          \
+            TYPE now_done = done | ((TYPE) 1 << r);                     \
+            TYPE now_ready = ready & ~((TYPE) 1 << r);                  \
+            for (TYPE next = succs[r]; next != 0; next &= next - 1) {   \
+                int q = CTZ(next);                                      \
+                if ((preds[q] & ~now_done) == 0) {                      \
+                    now_ready |= (TYPE) 1 << q;                         \
+                }                                                       \
+            }                                                           \
+            schedule_add(st->s, st->branch_order[r]);                   \
+            int soln = NAME(st, preds, succs, now_ready, now_done,      \
+                            best_soln);                                 \
+            if (start >= 0) {                                           \
+                st->resume_len = st->resume_at;                         \
+            }                                                           \
+            if (soln < 0) {                                             \
+                if (st->path != NULL &&                                 \
+                    idx_vec_push(st->path, r) != 0) {                   \
+                    return -1;                                          \
+                }                                                       \
+                return soln;                                            \
+            }                                                           \
+            best_soln = (best_soln < soln) ? best_soln : soln;          \
+            schedule_pop(st->s);                                        \
+            if (best_soln <= st->floor_bound) {                         \
+                break;                                                  \
+            }                                                           \
+        }                                                               \
+        return best_soln;                                               \
+    }                                                                   \
+                                                                        \
+    static int NAME##_run(search_state *st, unsigned upper) {           \
+        dag *g = schedule_dag(st->s);                                   \
+        size_t n = dag_size(g);                                         \
+        assert(n <= sizeof(TYPE) * CHAR_BIT);                           \
+        TYPE *preds = calloc(2 * n, sizeof(*preds));                    \
+        if (preds == NULL) {                                            \
+            return -1;                                                  \
+        }                                                               \
+        TYPE *succs = preds + n;                                        \
+        for (size_t i = 0; i < n; i++) {                                \
+            size_t nsuccs = dag_nsuccs(g, i);                           \
+            unsigned ids[nsuccs];                                       \
+            dag_succs(g, i, ids);                                       \
+            unsigned r = st->branch_rank[i];                            \
+            for (size_t j = 0; j < nsuccs; j++) {                       \
+                unsigned q = st->branch_rank[ids[j]];                   \
+                succs[r] |= (TYPE) 1 << q;                              \
+                preds[q] |= (TYPE) 1 << r;                              \
+            }                                                           \
+        }                                                               \
+        TYPE ready = 0;                                                 \
+        for (int r = bitmap_next(st->ready_set, 0); r >= 0;             \
+             r = bitmap_next(st->ready_set, r + 1)) {                   \
+            ready |= (TYPE) 1 << r;                                     \
+        }                                                               \
+        TYPE done = 0;                                                  \
+        for (size_t i = 0; i < schedule_size(st->s); i++) {             \
+            done |= (TYPE) 1 << st->branch_rank[schedule_get(st->s, i)]; \
+        }                                                               \
+        int result = NAME(st, preds, succs, ready, done, upper);        \
+        free(preds);                                                    \
+        return result;                                                  \
+    }
+
+DEFINE_MASK_SEARCH(bb64, uint64_t, ctz64)
+#ifdef __SIZEOF_INT128__
+DEFINE_MASK_SEARCH(bb128, uint128, ctz128)
+#endif
+#endif // NO_MASK_SEARCH
+
+// run the search starting from the known makespan `upper', which is
+// returned if no shorter schedule exists. The caller initialises the
+// atomics in `st'; everything else is set up here.
+static int search(search_state *st, dag *g, unsigned m, double timeout,
+                  bb_tiebreak tiebreak, unsigned upper) {
+    assert(st != NULL);
     assert(g != NULL);
+    assert(tiebreak != NULL);
+    int result = -1;
+    st->s = schedule_create(g, m);
+    if (st->s == NULL) {
+        goto err0;
+    }
+    schedule_add(st->s, dag_source(g));
+    for (size_t i = 0; i < st->prefix_len; i++) {
+        unsigned v = st->prefix[i];
+        if (v >= dag_size(g) || schedule_contains(st->s, v) ||
+            schedule_preds_left(st->s, v) != 0) {
+            goto err1;
+        }
+        schedule_add(st->s, v);
+    }
+    st->ready_set = bitmap_create(dag_size(g));
+    if (st->ready_set == NULL) {
+        goto err1;
+    }
+    if (branch_order_create(st, g, tiebreak) != 0) {
+        goto err2;
+    }
+    trace *t = atomic_load(&tracing);
+    st->trace = NULL;
+    if (t != NULL && (st->trace = trace_buffer_create(t)) == NULL) {
+        goto err3;
+    }
+
+    if (timeout < 0) {
+        st->do_timeout = 0;
+    }
+    else {
+        st->do_timeout = 1;
+        st->end_time = thread_time() + timeout;
+    }
+    st->slow = dag_size(g) >= SLOW_TASKS;
+    schedule_build(st->s, 0);
+    st->floor_bound = schedule_quick_bound(st->s);
+    if (st->target > st->floor_bound) {
+        st->floor_bound = st->target;
+    }
+    atomic_store(&st->incumbent, upper);
+
+    for (size_t i = 0; i < dag_size(g); i++) {
+        if (!schedule_contains(st->s, i) &&
+            schedule_preds_left(st->s, i) == 0) {
+            bitmap_set(st->ready_set, st->branch_rank[i], 1);
+        }
+    }
+#ifndef NO_MASK_SEARCH
+    if (dag_size(g) <= 64) {
+        result = bb64_run(st, upper);
+    }
+#ifdef __SIZEOF_INT128__
+    else if (dag_size(g) <= 128) {
+        result = bb128_run(st, upper);
+    }
+#endif
+    else {
+        result = bb(st, upper);
+    }
+#else
+    result = bb(st, upper);
+#endif // NO_MASK_SEARCH
+    atomic_store(&st->nodes, st->stats.nodes);
+ err3:
+    if (st->trace != NULL) {
+        trace_buffer_destroy(st->trace);
+    }
+#if defined(FUJITA) && defined(PROBES)
+    probes_destroy(st);
+#endif
+    branch_order_destroy(st);
+ err2:
+    bitmap_destroy(st->ready_set);
+ err1:
+    schedule_destroy(st->s);
+ err0:
+    last_stats = st->stats;
+    return result;
+}
+
+static void search_state_init(search_state *st) {
+    st->stats = (bbstats) {0};
+    st->path = NULL;
+    st->prefix = NULL;
+    st->prefix_len = 0;
+    st->resume = NULL;
+    st->resume_len = 0;
+    st->resume_at = 0;
+    st->target = 0;
+    st->node_limit = 0;
+    st->use_fujita = 1;
+    st->seed = 0;
+    st->shared = NULL;
+    st->stop = NULL;
+#if defined(FUJITA) && defined(PROBES)
+    for (size_t i = 0; i < PROBES; i++) {
+        st->probes[i] = NULL;
+    }
+#endif
+    atomic_init(&st->incumbent, UINT_MAX);
+    atomic_init(&st->nodes, 0);
+    atomic_init(&st->cancelled, 0);
+}
+
+int bbsearch(dag *g, unsigned m, int timeout) {
+    return bbsearch_tiebreak(g, m, timeout, bb_tiebreak_index);
+}
+
+int bbsearch_tiebreak(dag *g, unsigned m, int timeout, bb_tiebreak tiebreak) {
+    search_state st;
+    search_state_init(&st);
+    return search(&st, g, m, timeout, tiebreak, UINT_MAX);
+}
+
+// returns the largest of the bounds tried at the root of the search,
+// or -1 on error.
+static int root_bound(dag *g, unsigned m) {
     schedule *s = schedule_create(g, m);
     if (s == NULL) {
         return -1;
     }
-    schedule_add(s, dag_source(g));
-    bitmap *ready_set = bitmap_create(0);
-    if (ready_set == NULL) {
-        schedule_destroy(s);
+    int bound = -1;
+    if (schedule_add(s, dag_source(g)) == 0 && schedule_build(s, 0) == 0) {
+        bound = schedule_quick_bound(s);
+#ifdef FUJITA
+        int fb = schedule_fernandez_bound(s);
+        bound = (fb > bound) ? fb : bound;
+#ifndef FB
+        int mb = fujita_bound(s, NULL);
+        bound = (mb > bound) ? mb : bound;
+#endif // FB
+#endif // FUJITA
+    }
+    schedule_destroy(s);
+    return bound;
+}
+
+#ifdef FUJITA
+int bbsearch_fujita_bound(schedule *s, int parallel) {
+    assert(s != NULL);
+    if (schedule_build(s, 0) != 0) {
         return -1;
     }
+#ifdef PROBES
+    if (parallel) {
+        search_state st;
+        search_state_init(&st);
+        st.s = s;
+        st.do_timeout = 0;
+        st.slow = 0;
+        int bound = fujita_bound_parallel(&st);
+        probes_destroy(&st);
+        return bound;
+    }
+#endif // PROBES
+    return fujita_bound(s, NULL);
+}
+#endif // FUJITA
 
-    if (timeout < 0) {
-        do_timeout = 0;
+// runs bbsearch_deepening with `st', which the caller initialises.
+static int deepen(search_state *st, dag *g, unsigned m, int timeout,
+                  bb_tiebreak tiebreak) {
+    double start = thread_time();
+    int lower = root_bound(g, m);
+    if (lower < 0) {
+        last_stats = st->stats;
+        return -1;
+    }
+    // each pass either finds a schedule of length `target' or shows
+    // there is none, and the counters add up over the passes
+    int result;
+    for (unsigned target = lower; ; target++) {
+        // every shorter target has been ruled out, so a schedule this
+        // short found by another search is optimal
+        if (st->shared != NULL &&
+            atomic_load(st->shared) <= target) {
+            result = atomic_load(st->shared);
+            break;
+        }
+        double left = -1;
+        if (timeout >= 0) {
+            left = timeout - (thread_time() - start);
+            left = (left > 0) ? left : 0;
+        }
+        st->target = target;
+        result = search(st, g, m, left, tiebreak, target + 1);
+        if (result != (int) target + 1) {
+            break;
+        }
+    }
+    return result;
+}
+
+int bbsearch_deepening(dag *g, unsigned m, int timeout) {
+    assert(g != NULL);
+    search_state st;
+    search_state_init(&st);
+    return deepen(&st, g, m, timeout, bb_tiebreak_index);
+}
+
+int bbsearch_restarts(dag *g, unsigned m, int timeout, uint64_t seed) {
+    assert(g != NULL);
+    double start = thread_time();
+    search_state st;
+    search_state_init(&st);
+    gen_rng rng = {.state = seed};
+    unsigned upper = UINT_MAX;
+    unsigned long limit = RESTART_UNIT;
+    int result;
+    for (unsigned long i = 1; ; i++) {
+        double left = -1;
+        if (timeout >= 0) {
+            left = timeout - (thread_time() - start);
+            left = (left > 0) ? left : 0;
+        }
+        // the first search breaks ties like bbsearch, and a seed of 0
+        // would do the same
+        st.seed = (i == 1) ? 0 : gen_next(&rng) | 1;
+        st.node_limit = st.stats.nodes + limit;
+        result = search(&st, g, m, left, bb_tiebreak_index, upper);
+        if (result != -4) {
+            break;
+        }
+        unsigned found = atomic_load(&st.incumbent);
+        upper = (found < upper) ? found : upper;
+        st.stats.restarts++;
+        // stops growing well before the limit could overflow
+        if (limit <= ULONG_MAX / (4 * RESTART_GROWTH)) {
+            limit *= RESTART_GROWTH;
+        }
+    }
+    last_stats = st.stats;
+    return result;
+}
+
+int bbsearch_local(dag *g, unsigned m, int timeout, unsigned *found) {
+    assert(g != NULL);
+    double start = thread_time();
+    int upper = local_search(g, m, (timeout < 0) ? -1 : timeout * LOCAL_SHARE,
+                             LOCAL_MOVES * dag_size(g), 1, NULL);
+    if (upper < 0) {
+        return -1;
+    }
+    double left = -1;
+    if (timeout >= 0) {
+        left = timeout - (thread_time() - start);
+        left = (left > 0) ? left : 0;
+    }
+    search_state st;
+    search_state_init(&st);
+    int result = search(&st, g, m, left, bb_tiebreak_index, upper);
+    if (found != NULL) {
+        *found = atomic_load(&st.incumbent);
+    }
+    return result;
+}
+
+int bbsearch_range(dag *g, unsigned m_lo, unsigned m_hi, int timeout,
+                   int *results, double *times) {
+    assert(g != NULL);
+    assert(m_lo > 0 && m_lo <= m_hi);
+    assert(results != NULL);
+    // a schedule for m machines is also one for m + 1, so each
+    // makespan seeds the search for the next machine count
+    unsigned crit_path = dag_level(g, dag_source(g));
+    unsigned upper = UINT_MAX;
+    search_state st;
+    for (unsigned m = m_lo; m <= m_hi; m++) {
+        double start = report_time();
+        search_state_init(&st);
+        int result;
+        if (upper == crit_path) {
+            // more machines cannot beat the critical path
+            last_stats = st.stats;
+            result = crit_path;
+        }
+        else {
+            result = search(&st, g, m, timeout, bb_tiebreak_index, upper);
+            if (result == -1) {
+                return -1;
+            }
+        }
+        results[m - m_lo] = result;
+        if (times != NULL) {
+            times[m - m_lo] = report_time() - start;
+        }
+        upper = (result >= 0) ? result : atomic_load(&st.incumbent);
+    }
+    return 0;
+}
+
+// a checkpoint is a header of 32-bit words (magic, version, dag size
+// and m), the dag's hash, the incumbent, the counters, the path length
+// and the ranks on the path from the root down.
+static int checkpoint_save(const char *path, dag *g, unsigned m,
+                           search_state *st) {
+    // write to a temporary file first so that a crash never leaves a
+    // truncated checkpoint behind
+    size_t len = strlen(path);
+    char tmp[len + 5];
+    sprintf(tmp, "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+    uint32_t header[] = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION, dag_size(g), m};
+    uint64_t hash = dag_hash(g);
+    uint32_t incumbent = atomic_load(&st->incumbent);
+    uint64_t counters[BB_NTIERS + 1] = {st->stats.nodes};
+    for (size_t i = 0; i < BB_NTIERS; i++) {
+        counters[i + 1] = st->stats.pruned[i];
+    }
+    uint32_t depth = st->path->size;
+    uint32_t ranks[depth + 1];
+    for (size_t i = 0; i < depth; i++) {
+        ranks[i] = st->path->data[depth - i - 1];
+    }
+    int ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+        fwrite(&hash, sizeof(hash), 1, f) == 1 &&
+        fwrite(&incumbent, sizeof(incumbent), 1, f) == 1 &&
+        fwrite(counters, sizeof(counters), 1, f) == 1 &&
+        fwrite(&depth, sizeof(depth), 1, f) == 1 &&
+        fwrite(ranks, sizeof(*ranks), depth, f) == depth;
+    if (fclose(f) != 0 || !ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// fills in the incumbent, counters and resume path of `st' from the
+// checkpoint in `f', which must be for `g' and `m'. The caller frees
+// `st->resume'.
+static int checkpoint_load(FILE *f, dag *g, unsigned m, search_state *st) {
+    uint32_t header[4];
+    uint64_t hash;
+    uint32_t incumbent;
+    uint64_t counters[BB_NTIERS + 1];
+    uint32_t depth;
+    if (fread(header, sizeof(header), 1, f) != 1 ||
+        fread(&hash, sizeof(hash), 1, f) != 1 ||
+        fread(&incumbent, sizeof(incumbent), 1, f) != 1 ||
+        fread(counters, sizeof(counters), 1, f) != 1 ||
+        fread(&depth, sizeof(depth), 1, f) != 1) {
+        return -1;
+    }
+    if (header[0] != CHECKPOINT_MAGIC || header[1] != CHECKPOINT_VERSION ||
+        header[2] != dag_size(g) || header[3] != m ||
+        hash != dag_hash(g) || depth > dag_size(g)) {
+        fprintf(stderr, "Checkpoint does not match the dag\n");
+        return -1;
+    }
+    unsigned *ranks = malloc((depth + 1) * sizeof(*ranks));
+    if (ranks == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < depth; i++) {
+        uint32_t rank;
+        if (fread(&rank, sizeof(rank), 1, f) != 1) {
+            free(ranks);
+            return -1;
+        }
+        ranks[i] = rank;
+    }
+    atomic_store(&st->incumbent, incumbent);
+    st->stats.nodes = counters[0];
+    for (size_t i = 0; i < BB_NTIERS; i++) {
+        st->stats.pruned[i] = counters[i + 1];
+    }
+    st->resume = ranks;
+    st->resume_len = depth;
+    return 0;
+}
+
+int bbsearch_resumable(dag *g, unsigned m, int timeout, const char *path) {
+    return bbsearch_resumable_nodes(g, m, timeout, 0, path);
+}
+
+int bbsearch_resumable_nodes(dag *g, unsigned m, int timeout,
+                             unsigned long nodes, const char *path) {
+    assert(g != NULL);
+    assert(path != NULL);
+    search_state st;
+    search_state_init(&st);
+    FILE *f = fopen(path, "rb");
+    if (f != NULL) {
+        int err = checkpoint_load(f, g, m, &st);
+        fclose(f);
+        if (err != 0) {
+            return -1;
+        }
+    }
+    if (nodes != 0) {
+        st.node_limit = st.stats.nodes + nodes;
+    }
+    idx_vec stopped = {0};
+    st.path = &stopped;
+    int result = search(&st, g, m, timeout, bb_tiebreak_index,
+                        atomic_load(&st.incumbent));
+    result = (result == -4) ? -2 : result;
+    if (result == -2 && checkpoint_save(path, g, m, &st) != 0) {
+        result = -1;
+    }
+    else if (result >= 0) {
+        remove(path);
+    }
+    idx_vec_destroy(&stopped);
+    free((unsigned *) st.resume);
+    return result;
+}
+
+int bbsearch_trace(const char *path) {
+    int err = 0;
+    trace *old = atomic_exchange(&tracing, NULL);
+    if (old != NULL) {
+        err = trace_close(old);
+    }
+    if (path != NULL) {
+        trace *t = trace_open(path);
+        if (t == NULL) {
+            return -1;
+        }
+        atomic_store(&tracing, t);
+    }
+    return err;
+}
+
+void bbsearch_interrupt(void) {
+    atomic_store(&interrupted, 1);
+}
+
+void bbsearch_stats(bbstats *out) {
+    assert(out != NULL);
+    *out = last_stats;
+}
+
+static void pool_create(void) {
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    pool = threadpool_create((ncpus > 0) ? ncpus : 1);
+}
+
+static void job_run(void *arg) {
+    bbjob *job = arg;
+    int result = search(&job->st, job->g, job->m, job->timeout,
+                        bb_tiebreak_index, job->upper);
+    pthread_mutex_lock(&job->lock);
+    job->result = result;
+    job->done = 1;
+    pthread_cond_broadcast(&job->finished);
+    pthread_mutex_unlock(&job->lock);
+}
+
+bbjob *bbsearch_start(dag *g, unsigned m, int timeout) {
+    return bbsearch_start_prefix(g, m, timeout, NULL, 0, UINT_MAX);
+}
+
+bbjob *bbsearch_start_prefix(dag *g, unsigned m, int timeout,
+                             const unsigned *prefix, size_t len,
+                             unsigned upper) {
+    assert(g != NULL);
+    assert(prefix != NULL || len == 0);
+    pthread_once(&pool_once, pool_create);
+    if (pool == NULL) {
+        return NULL;
+    }
+    bbjob *job = malloc(sizeof(*job));
+    if (job == NULL) {
+        return NULL;
+    }
+    job->prefix = malloc((len > 0 ? len : 1) * sizeof(*job->prefix));
+    if (job->prefix == NULL) {
+        free(job);
+        return NULL;
+    }
+    if (len > 0) {
+        memcpy(job->prefix, prefix, len * sizeof(*job->prefix));
+    }
+    job->g = g;
+    job->m = m;
+    job->timeout = timeout;
+    job->upper = upper;
+    atomic_init(&job->bound, upper);
+    search_state_init(&job->st);
+    job->st.prefix = job->prefix;
+    job->st.prefix_len = len;
+    job->st.shared = &job->bound;
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->finished, NULL);
+    job->done = 0;
+    job->result = -1;
+    if (threadpool_submit(pool, job_run, job) != 0) {
+        pthread_cond_destroy(&job->finished);
+        pthread_mutex_destroy(&job->lock);
+        free(job->prefix);
+        free(job);
+        return NULL;
+    }
+    return job;
+}
+
+int bbsearch_poll(bbjob *job, unsigned *incumbent, unsigned long *nodes) {
+    assert(job != NULL);
+    if (incumbent != NULL) {
+        *incumbent = atomic_load(&job->st.incumbent);
+    }
+    if (nodes != NULL) {
+        *nodes = atomic_load(&job->st.nodes);
+    }
+    pthread_mutex_lock(&job->lock);
+    int done = job->done;
+    pthread_mutex_unlock(&job->lock);
+    return done;
+}
+
+void bbsearch_lower(bbjob *job, unsigned bound) {
+    assert(job != NULL);
+    lower_to(&job->bound, bound);
+}
+
+void bbsearch_cancel(bbjob *job) {
+    assert(job != NULL);
+    atomic_store(&job->st.cancelled, 1);
+}
+
+int bbsearch_join(bbjob *job) {
+    assert(job != NULL);
+    pthread_mutex_lock(&job->lock);
+    while (!job->done) {
+        pthread_cond_wait(&job->finished, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+    int result = job->result;
+    last_stats = job->st.stats;
+    pthread_cond_destroy(&job->finished);
+    pthread_mutex_destroy(&job->lock);
+    free(job->prefix);
+    free(job);
+    return result;
+}
+
+// a search run as part of a portfolio.
+typedef struct member {
+    struct portfolio *pf;
+    bbconfig config;
+    search_state st;
+    int result;
+} member;
+
+typedef struct portfolio {
+    dag *g;
+    unsigned m;
+    int timeout;
+    atomic_uint incumbent;
+    atomic_int stop;
+
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    size_t running;
+} portfolio;
+
+// the deepening search usually wins, so it goes first in case there
+// are fewer threads than searches
+static const bbconfig default_portfolio[] = {
+    {.tiebreak = bb_tiebreak_index, .deepening = 1},
+    {.tiebreak = bb_tiebreak_index},
+    {.tiebreak = bb_tiebreak_weight, .fernandez_only = 1},
+    {.tiebreak = bb_tiebreak_succs, .seed = 1},
+};
+
+static void member_run(void *arg) {
+    member *mb = arg;
+    portfolio *pf = mb->pf;
+    int result;
+    if (mb->config.deepening) {
+        result = deepen(&mb->st, pf->g, pf->m, pf->timeout,
+                        mb->config.tiebreak);
     }
     else {
-        do_timeout = 1;
-        end_time = clock() + timeout * CLOCKS_PER_SEC;
+        result = search(&mb->st, pf->g, pf->m, pf->timeout,
+                        mb->config.tiebreak, UINT_MAX);
+    }
+    if (result >= 0) {
+        atomic_store(&pf->stop, 1);
     }
+    pthread_mutex_lock(&pf->lock);
+    mb->result = result;
+    pf->running--;
+    pthread_cond_broadcast(&pf->finished);
+    pthread_mutex_unlock(&pf->lock);
+}
 
-    size_t nsuccs = dag_nsuccs(g, dag_source(g));
-    unsigned succs[nsuccs];
-    dag_succs(g, dag_source(g), succs);
-    for (size_t i = 0; i < nsuccs; i++) {
-        bitmap_set(ready_set, succs[i], 1);
+int bbsearch_portfolio(dag *g, unsigned m, int timeout,
+                       const bbconfig *configs, size_t nconfigs) {
+    assert(g != NULL);
+    if (configs == NULL) {
+        configs = default_portfolio;
+        nconfigs = sizeof(default_portfolio) / sizeof(*default_portfolio);
     }
-    int result = bb(s, ready_set, UINT_MAX);
-    bitmap_destroy(ready_set);
-    schedule_destroy(s);
+    assert(nconfigs > 0);
+    pthread_once(&pool_once, pool_create);
+    if (pool == NULL) {
+        return -1;
+    }
+    member *members = malloc(nconfigs * sizeof(*members));
+    if (members == NULL) {
+        return -1;
+    }
+    portfolio pf = {
+        .g = g,
+        .m = m,
+        .timeout = timeout,
+        .running = 0,
+    };
+    atomic_init(&pf.incumbent, UINT_MAX);
+    atomic_init(&pf.stop, 0);
+    pthread_mutex_init(&pf.lock, NULL);
+    pthread_cond_init(&pf.finished, NULL);
+
+    int failed = 0;
+    size_t started;
+    for (started = 0; started < nconfigs; started++) {
+        member *mb = &members[started];
+        assert(configs[started].tiebreak != NULL);
+        mb->pf = &pf;
+        mb->config = configs[started];
+        mb->result = -1;
+        search_state_init(&mb->st);
+        mb->st.seed = mb->config.seed;
+        mb->st.use_fujita = !mb->config.fernandez_only;
+        mb->st.shared = &pf.incumbent;
+        mb->st.stop = &pf.stop;
+        pthread_mutex_lock(&pf.lock);
+        pf.running++;
+        pthread_mutex_unlock(&pf.lock);
+        if (threadpool_submit(pool, member_run, mb) != 0) {
+            pthread_mutex_lock(&pf.lock);
+            pf.running--;
+            pthread_mutex_unlock(&pf.lock);
+            atomic_store(&pf.stop, 1);
+            failed = 1;
+            break;
+        }
+    }
+    pthread_mutex_lock(&pf.lock);
+    while (pf.running > 0) {
+        pthread_cond_wait(&pf.finished, &pf.lock);
+    }
+    pthread_mutex_unlock(&pf.lock);
+
+    // the searches that finished agree on the makespan; the others
+    // were stopped, timed out or failed
+    int result = -1;
+    int timed_out = 0;
+    bbstats total = {0};
+    for (size_t i = 0; i < started; i++) {
+        int r = members[i].result;
+        if (r >= 0) {
+            result = (result < 0 || r < result) ? r : result;
+        }
+        timed_out |= r == -2;
+        failed |= r == -1;
+        total.nodes += members[i].st.stats.nodes;
+        for (size_t t = 0; t < BB_NTIERS; t++) {
+            total.pruned[t] += members[i].st.stats.pruned[t];
+        }
+        total.restarts += members[i].st.stats.restarts;
+    }
+    if (result < 0) {
+        result = (timed_out && !failed) ? -2 : -1;
+    }
+    last_stats = total;
+    pthread_cond_destroy(&pf.finished);
+    pthread_mutex_destroy(&pf.lock);
+    free(members);
     return result;
 }
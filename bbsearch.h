@@ -1,12 +1,176 @@
 #ifndef BBSEARCH_H
 #define BBSEARCH_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "dag.h"
+#include "schedule.h"
+
+// lower bounds are tried in this order at every search node, cheapest
+// first, until one of them prunes the node.
+enum bb_tier {
+    BB_TIER_QUICK,
+    BB_TIER_FERNANDEZ,
+    BB_TIER_FUJITA,
+    BB_NTIERS,
+};
+
+typedef struct bbstats {
+    unsigned long nodes;
+    unsigned long pruned[BB_NTIERS];
+    // searches given up on and started over by bbsearch_restarts
+    unsigned long restarts;
+} bbstats;
+
+// ranks ready tasks of equal level when branching. Tasks with larger
+// keys are tried first.
+typedef long (*bb_tiebreak)(dag *g, unsigned id);
+
+// prefer tasks given earlier to dag_vertex, heavier tasks, or tasks
+// with more successors.
+long bb_tiebreak_index(dag *g, unsigned id);
+long bb_tiebreak_weight(dag *g, unsigned id);
+long bb_tiebreak_succs(dag *g, unsigned id);
+
+// one of the searches run side by side by bbsearch_portfolio.
+typedef struct bbconfig {
+    bb_tiebreak tiebreak;
+    // if not 0, tasks the tiebreak cannot tell apart are branched on in
+    // an order drawn from this seed instead of by id
+    uint64_t seed;
+    // stop at the Fernandez bound instead of going on to Fujita's
+    // binary search method, as builds with FB always do
+    int fernandez_only;
+    // search like bbsearch_deepening instead of bbsearch
+    int deepening;
+} bbconfig;
+
+// a search running in the background.
+struct bbjob;
+typedef struct bbjob bbjob;
 
 // returns the makespan of the dag `g' run on `m' machines. Time out
-// after `timeout' seconds, or not at all if `timeout' is
+// after `timeout' seconds of CPU time, or not at all if `timeout' is
 // negative. Returns the length of the optimal schedule if found, -1
 // on error, and -2 on time out.
 int bbsearch(dag *g, unsigned m, int timeout);
 
+// same as bbsearch, but breaks ties between ready tasks of equal level
+// with `tiebreak' instead of bb_tiebreak_index.
+int bbsearch_tiebreak(dag *g, unsigned m, int timeout, bb_tiebreak tiebreak);
+
+// same as bbsearch, but instead of improving on the shortest schedule
+// found so far, asks whether there is a schedule of length T, for T
+// from the bound at the root upwards. Each pass prunes every node that
+// cannot finish by T, so this is faster than bbsearch when the
+// makespan is at or just above the bound, and slower when it is far
+// above it. `timeout' covers all the passes.
+int bbsearch_deepening(dag *g, unsigned m, int timeout);
+
+// same as bbsearch, but first looks for a short schedule with
+// local_search and only searches for shorter ones. The local search
+// makes a fixed number of moves per task, but stops early once it has
+// used a tenth of `timeout', and the rest is left to the search.
+// Stores the makespan of the shortest schedule found in `found' unless
+// it is NULL, also when the search times out.
+int bbsearch_local(dag *g, unsigned m, int timeout, unsigned *found);
+
+// same as bbsearch, but gives up on the search after a number of nodes
+// and starts over, breaking ties between tasks in a different random
+// order drawn from `seed' each time. Each search is allowed twice as
+// many nodes as the one before it, so the search is still complete. The
+// shortest schedule found so far carries over to the next search. `timeout'
+// covers all the searches, and the counters add up over them.
+int bbsearch_restarts(dag *g, unsigned m, int timeout, uint64_t seed);
+
+// runs the `nconfigs' searches described by `configs' side by side on
+// the dag `g'. They all prune against the shortest makespan any of
+// them has found, and all stop as soon as one of them finishes. If
+// `configs' is NULL a built-in mix of searches is run. `timeout'
+// applies to each search separately. Returns what bbsearch would, and
+// the counters add up over the searches.
+int bbsearch_portfolio(dag *g, unsigned m, int timeout,
+                       const bbconfig *configs, size_t nconfigs);
+
+// solves the dag for every number of machines from `m_lo' to `m_hi',
+// storing what bbsearch would return for m in `results[m - m_lo]' and
+// the time spent on it, by the wall clock if built with PROBES, in
+// `times[m - m_lo]' unless `times' is NULL. Each makespan is used as
+// the starting point for the next m, and once the critical path is
+// reached the remaining m are not searched. `timeout' applies to each
+// m separately. Returns 0 on success and -1 on error.
+int bbsearch_range(dag *g, unsigned m_lo, unsigned m_hi, int timeout,
+                   int *results, double *times);
+
+// same as bbsearch, but when the search times out or is interrupted it
+// is saved to the file `path', and a later call with the same dag, m
+// and path continues from where it stopped. The counters carry over
+// between the calls. The file is removed once the makespan is
+// found. Returns -1 if `path' holds a checkpoint for a different dag
+// or m.
+int bbsearch_resumable(dag *g, unsigned m, int timeout, const char *path);
+
+// same as bbsearch_resumable, but also stops and saves the search once
+// it has visited `nodes' more nodes, unless `nodes' is 0.
+int bbsearch_resumable_nodes(dag *g, unsigned m, int timeout,
+                             unsigned long nodes, const char *path);
+
+// records every node of the searches started from now on, on any
+// thread, in the file `path', or stops recording if `path' is NULL.
+// Each search appends to a buffer of its own and writes it to the file
+// when it fills up and when the search finishes. Must not be called
+// while a search is running. Returns 0 on success and -1 if the file
+// cannot be created or the previous one was not written in full.
+int bbsearch_trace(const char *path);
+
+// makes every search, including those started later, stop as if it
+// had timed out. Safe to call from a signal handler.
+void bbsearch_interrupt(void);
+
+// fills `stats' with the counters from the most recent search run or
+// joined on the calling thread.
+void bbsearch_stats(bbstats *stats);
+
+// starts the same search as bbsearch on a background thread and
+// returns a handle to it, or NULL on error. `g' must not be changed
+// or destroyed until the job is joined.
+bbjob *bbsearch_start(dag *g, unsigned m, int timeout);
+
+// same as bbsearch_start, but only searches the schedules that start
+// with the `len' tasks in `prefix', in that order, right after the
+// source, for one shorter than `upper'. The job returns `upper' if
+// there is none, and -1 if the prefix is not a valid start of a
+// schedule. `prefix' is copied.
+bbjob *bbsearch_start_prefix(dag *g, unsigned m, int timeout,
+                             const unsigned *prefix, size_t len,
+                             unsigned upper);
+
+// tells the job that a schedule of length `bound' is known, so that it
+// only looks for shorter ones from then on.
+void bbsearch_lower(bbjob *job, unsigned bound);
+
+// stores the shortest makespan found so far, or the upper bound the
+// job started from (UINT_MAX for bbsearch_start) if there is none yet,
+// in `incumbent' and the number of nodes searched in
+// `nodes'. Either may be NULL. Returns 1 if the job has finished and 0
+// otherwise.
+int bbsearch_poll(bbjob *job, unsigned *incumbent, unsigned long *nodes);
+
+// asks the job to stop as soon as possible. Does not wait for it.
+void bbsearch_cancel(bbjob *job);
+
+// waits for the job to finish and frees it. Returns what bbsearch
+// would, or -3 if the job was cancelled before it finished.
+int bbsearch_join(bbjob *job);
+
+#ifdef FUJITA
+// returns Fujita's lower bound on every completion of the partial
+// schedule `s', as the search computes it at a node. If `parallel' is
+// set and PROBES is defined it tries PROBES horizons at once, as the
+// search does while enough tasks are left, which gives the same bound.
+// Returns -1 on error.
+int bbsearch_fujita_bound(schedule *s, int parallel);
+#endif // FUJITA
+
 #endif // BBSEARCH_H
@@ -58,3 +58,20 @@ int bitmap_set(bitmap *bm, unsigned idx, int val) {
     bm->vec.data[cell_idx] |= (val ? 1 : 0) << bit_idx;
     return old_val;
 }
+
+int bitmap_next(bitmap *bm, unsigned idx) {
+    assert(bm != NULL);
+    unsigned cell_idx = idx / CELL_WIDTH;
+    if (cell_idx >= bm->vec.size) {
+        return -1;
+    }
+    // mask off the bits below `idx' in its own cell
+    cell c = bm->vec.data[cell_idx] & (~(cell) 0 << (idx % CELL_WIDTH));
+    while (c == 0) {
+        if (++cell_idx >= bm->vec.size) {
+            return -1;
+        }
+        c = bm->vec.data[cell_idx];
+    }
+    return cell_idx * CELL_WIDTH + __builtin_ctz(c);
+}
@@ -17,4 +17,8 @@ int bitmap_get(bitmap *bm, unsigned idx);
 // return the old value at idx, or -1 on error.
 int bitmap_set(bitmap *bm, unsigned idx, int val);
 
+// return the smallest set index that is at least `idx', or -1 if
+// there is none.
+int bitmap_next(bitmap *bm, unsigned idx);
+
 #endif // BITMAP_H
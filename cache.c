@@ -0,0 +1,216 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vector.h"
+#include "dag.h"
+#include "cache.h"
+
+#define NONE ((size_t) -1)
+
+typedef struct entry {
+    uint64_t hash;
+    unsigned m;
+    int result;
+    // the dag the result belongs to, as written by encode, since
+    // different dags may share a hash
+    idx_vec key;
+    // neighbours in recency order and the next entry in the same bucket
+    size_t prev;
+    size_t next;
+    size_t chain;
+} entry;
+
+struct cache {
+    size_t capacity;
+    size_t size;
+    entry *entries;
+    size_t nbuckets;
+    size_t *buckets;
+    // most and least recently used entries
+    size_t head;
+    size_t tail;
+};
+
+// write out the size of `g', then the weight, the number of successors
+// and the successors of every vertex in id order.
+static int encode(dag *g, idx_vec *key) {
+    size_t n = dag_size(g);
+    if (idx_vec_init(key, 2 * n + 1) != 0) {
+        return -1;
+    }
+    int err = idx_vec_push(key, n);
+    for (size_t i = 0; i < n && err == 0; i++) {
+        size_t nsuccs = dag_nsuccs(g, i);
+        unsigned succs[nsuccs];
+        dag_succs(g, i, succs);
+        err |= idx_vec_push(key, dag_weight(g, i));
+        err |= idx_vec_push(key, nsuccs);
+        for (size_t j = 0; j < nsuccs; j++) {
+            err |= idx_vec_push(key, succs[j]);
+        }
+    }
+    if (err != 0) {
+        idx_vec_destroy(key);
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t hash(dag *g, unsigned m) {
+    // mix in m so that entries for the same dag spread over buckets
+    return dag_hash(g) ^ ((uint64_t) m * 0x9e3779b97f4a7c15ULL);
+}
+
+cache *cache_create(size_t capacity) {
+    assert(capacity > 0);
+    cache *c = malloc(sizeof(*c));
+    if (c == NULL) {
+        goto err0;
+    }
+    c->entries = malloc(capacity * sizeof(*c->entries));
+    if (c->entries == NULL) {
+        goto err1;
+    }
+    // keep the chains short with a power of two at least twice the
+    // capacity
+    for (c->nbuckets = 1; c->nbuckets < 2 * capacity; c->nbuckets *= 2);
+    c->buckets = malloc(c->nbuckets * sizeof(*c->buckets));
+    if (c->buckets == NULL) {
+        goto err2;
+    }
+    for (size_t i = 0; i < c->nbuckets; i++) {
+        c->buckets[i] = NONE;
+    }
+    c->capacity = capacity;
+    c->size = 0;
+    c->head = NONE;
+    c->tail = NONE;
+    return c;
+
+ err2:
+    free(c->entries);
+ err1:
+    free(c);
+ err0:
+    return NULL;
+}
+
+void cache_destroy(cache *c) {
+    assert(c != NULL);
+    for (size_t i = 0; i < c->size; i++) {
+        idx_vec_destroy(&c->entries[i].key);
+    }
+    free(c->entries);
+    free(c->buckets);
+    free(c);
+}
+
+size_t cache_size(cache *c) {
+    assert(c != NULL);
+    return c->size;
+}
+
+static void lru_unlink(cache *c, size_t idx) {
+    entry *e = &c->entries[idx];
+    if (e->prev != NONE) {
+        c->entries[e->prev].next = e->next;
+    }
+    else {
+        c->head = e->next;
+    }
+    if (e->next != NONE) {
+        c->entries[e->next].prev = e->prev;
+    }
+    else {
+        c->tail = e->prev;
+    }
+}
+
+static void lru_push_front(cache *c, size_t idx) {
+    entry *e = &c->entries[idx];
+    e->prev = NONE;
+    e->next = c->head;
+    if (c->head != NONE) {
+        c->entries[c->head].prev = idx;
+    }
+    c->head = idx;
+    if (c->tail == NONE) {
+        c->tail = idx;
+    }
+}
+
+static size_t find(cache *c, idx_vec *key, unsigned m, uint64_t h) {
+    for (size_t idx = c->buckets[h & (c->nbuckets - 1)]; idx != NONE;
+         idx = c->entries[idx].chain) {
+        entry *e = &c->entries[idx];
+        if (e->hash == h && e->m == m && e->key.size == key->size &&
+            memcmp(e->key.data, key->data,
+                   key->size * sizeof(*key->data)) == 0) {
+            return idx;
+        }
+    }
+    return NONE;
+}
+
+int cache_get(cache *c, dag *g, unsigned m, int *result) {
+    assert(c != NULL);
+    assert(g != NULL);
+    assert(result != NULL);
+    idx_vec key;
+    if (encode(g, &key) != 0) {
+        return -1;
+    }
+    size_t idx = find(c, &key, m, hash(g, m));
+    idx_vec_destroy(&key);
+    if (idx == NONE) {
+        return -1;
+    }
+    lru_unlink(c, idx);
+    lru_push_front(c, idx);
+    *result = c->entries[idx].result;
+    return 0;
+}
+
+int cache_put(cache *c, dag *g, unsigned m, int result) {
+    assert(c != NULL);
+    assert(g != NULL);
+    idx_vec key;
+    if (encode(g, &key) != 0) {
+        return -1;
+    }
+    uint64_t h = hash(g, m);
+    size_t idx = find(c, &key, m, h);
+    if (idx != NONE) {
+        idx_vec_destroy(&key);
+        c->entries[idx].result = result;
+        lru_unlink(c, idx);
+        lru_push_front(c, idx);
+        return 0;
+    }
+
+    if (c->size < c->capacity) {
+        idx = c->size++;
+    }
+    else {
+        // reuse the least recently used entry
+        idx = c->tail;
+        size_t *link = &c->buckets[c->entries[idx].hash & (c->nbuckets - 1)];
+        while (*link != idx) {
+            link = &c->entries[*link].chain;
+        }
+        *link = c->entries[idx].chain;
+        lru_unlink(c, idx);
+        idx_vec_destroy(&c->entries[idx].key);
+    }
+    entry *e = &c->entries[idx];
+    e->hash = h;
+    e->m = m;
+    e->result = result;
+    e->key = key;
+    e->chain = c->buckets[h & (c->nbuckets - 1)];
+    c->buckets[h & (c->nbuckets - 1)] = idx;
+    lru_push_front(c, idx);
+    return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdlib.h>
+
+#include "dag.h"
+
+struct cache;
+typedef struct cache cache;
+
+// create a cache holding the makespans of up to `capacity' (dag, m)
+// pairs, evicting the least recently used pair when full. Dags are
+// compared by their weights and successor lists, so two dags built
+// from the same input share an entry. Returns NULL on failure.
+cache *cache_create(size_t capacity);
+
+// clean up resources associated with the cache.
+void cache_destroy(cache *c);
+
+// returns the number of pairs in the cache.
+size_t cache_size(cache *c);
+
+// store the makespan of the built dag `g' on `m' machines in
+// `result'. Return 0 if it was cached and -1 otherwise.
+int cache_get(cache *c, dag *g, unsigned m, int *result);
+
+// remember `result' as the makespan of the built dag `g' on `m'
+// machines. Return 0 on success and -1 on failure.
+int cache_put(cache *c, dag *g, unsigned m, int result);
+
+#endif // CACHE_H
@@ -1,12 +1,14 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "vector.h"
-#include "bitmap.h"
-#include "binheap.h"
 #include "dag.h"
 
+#define FNV_OFFSET (14695981039346656037ULL)
+#define FNV_PRIME (1099511628211ULL)
+
 // holds all node-specific data
 typedef struct node {
     int weight;
@@ -40,6 +42,10 @@ DEFINE_VECTOR(node_vec, node);
 
 struct dag {
     node_vec nodes;
+    unsigned *order;
+    // the id each vertex was given by dag_vertex, or NULL if the
+    // vertices were never renumbered
+    unsigned *input_ids;
     int built;
 };
 
@@ -59,6 +65,8 @@ dag *dag_create(void) {
     if (node_vec_push(&g->nodes, s) != 0) {
         goto err3;
     }
+    g->order = NULL;
+    g->input_ids = NULL;
     g->built = 0;
     return g;
  err3:
@@ -76,6 +84,8 @@ void dag_destroy(dag *g) {
         node_destroy(&g->nodes.data[i]);
     }
     node_vec_destroy(&g->nodes);
+    free(g->order);
+    free(g->input_ids);
     free(g);
 }
 
@@ -112,34 +122,38 @@ unsigned dag_vertex(dag *g, int weight, size_t n_deps, unsigned *deps) {
     return idx;
 }
 
-// calculate lvl
-static void lvl_visit(dag *g, unsigned idx, idx_vec *lvl_ready,
-                      bitmap *lvl_finished) {
-    size_t npreds = dag_npreds(g, idx);
-    unsigned preds[npreds];
-    dag_preds(g, idx, preds);
-    for (size_t i = 0; i < npreds; i++) {
-        unsigned pred = preds[i];
-        size_t nsuccs = dag_nsuccs(g, pred);
-        unsigned succs[nsuccs];
-        dag_succs(g, pred, succs);
-        int succs_complete = 1;
-        unsigned max_level = 0;
-        for (size_t j = 0; j < nsuccs; j++) {
-            if (bitmap_get(lvl_finished, succs[j]) != 1) {
-                succs_complete = 0;
-                break;
-            }
-            max_level = (g->nodes.data[succs[j]].level > max_level) ?
-                g->nodes.data[succs[j]].level : max_level;
+// order the vertices so that every vertex comes after all of its
+// predecessors.
+static int topo_sort(dag *g) {
+    size_t n = dag_size(g);
+    g->order = malloc(n * sizeof(*g->order));
+    unsigned *npreds = malloc(n * sizeof(*npreds));
+    if (g->order == NULL || npreds == NULL) {
+        free(g->order);
+        free(npreds);
+        g->order = NULL;
+        return -1;
+    }
+    size_t tail = 0;
+    for (size_t i = 0; i < n; i++) {
+        npreds[i] = g->nodes.data[i].preds.size;
+        if (npreds[i] == 0) {
+            g->order[tail++] = i;
         }
-        // all successors have calculated levels
-        if (succs_complete) {
-            g->nodes.data[pred].level = dag_weight(g, pred) + max_level;
-            bitmap_set(lvl_finished, pred, 1);
-            idx_vec_push(lvl_ready, pred);
+    }
+    // the order doubles as the queue of vertices whose predecessors
+    // have all been placed
+    for (size_t head = 0; head < tail; head++) {
+        idx_vec *succs = &g->nodes.data[g->order[head]].succs;
+        for (size_t j = 0; j < succs->size; j++) {
+            if (--npreds[succs->data[j]] == 0) {
+                g->order[tail++] = succs->data[j];
+            }
         }
     }
+    free(npreds);
+    assert(tail == n);
+    return 0;
 }
 
 int dag_build(dag *g) {
@@ -157,29 +171,194 @@ int dag_build(dag *g) {
         dag_vertex(g, 0, exit_nodes.size, exit_nodes.data);
         idx_vec_destroy(&exit_nodes);
 
-        // calculate level of each vertex
-        idx_vec lvl_ready;
-        if (idx_vec_init(&lvl_ready, 0) != 0) {
-            return -1;
-        }
-        bitmap *lvl_finished = bitmap_create(dag_size(g));
-        if (lvl_finished == NULL) {
+        if (topo_sort(g) != 0) {
             return -1;
         }
-        idx_vec_push(&lvl_ready, dag_sink(g));
-        bitmap_set(lvl_finished, dag_sink(g), 1);
-        while (lvl_ready.size > 0) {
-            unsigned idx;
-            idx_vec_pop(&lvl_ready, &idx);
-            lvl_visit(g, idx, &lvl_ready, lvl_finished);
+
+        // calculate level of each vertex, successors first
+        for (size_t i = dag_size(g); i-- > 0;) {
+            node *v = &g->nodes.data[g->order[i]];
+            unsigned max_level = 0;
+            for (size_t j = 0; j < v->succs.size; j++) {
+                unsigned level = g->nodes.data[v->succs.data[j]].level;
+                max_level = (level > max_level) ? level : max_level;
+            }
+            v->level = v->weight + max_level;
         }
-        idx_vec_destroy(&lvl_ready);
-        bitmap_destroy(lvl_finished);
     }
     g->built = 1;
     return 0;
 }
 
+// removes the first `id' from `vec', keeping the others in order.
+static void remove_idx(idx_vec *vec, unsigned id) {
+    for (size_t i = 0; i < vec->size; i++) {
+        if (vec->data[i] == id) {
+            memmove(&vec->data[i], &vec->data[i + 1],
+                    (--vec->size - i) * sizeof(*vec->data));
+            return;
+        }
+    }
+}
+
+// drop every edge (v, s) where s can also be reached from v through
+// another successor, sweeping successors first so that the set of
+// vertices reachable from each successor is already known.
+static int reduce(dag *g, size_t *removed) {
+    size_t n = dag_size(g);
+    size_t words = (n + 63) / 64;
+    uint64_t *reach = calloc(n * words, sizeof(*reach));
+    if (reach == NULL) {
+        return -1;
+    }
+    *removed = 0;
+    for (size_t i = n; i-- > 0;) {
+        unsigned v = g->order[i];
+        node *nv = &g->nodes.data[v];
+        uint64_t *rv = &reach[v * words];
+        for (size_t j = 0; j < nv->succs.size; j++) {
+            uint64_t *rs = &reach[nv->succs.data[j] * words];
+            for (size_t w = 0; w < words; w++) {
+                rv[w] |= rs[w];
+            }
+        }
+        // a successor already in the set is reachable some other way,
+        // or is a repeat of an edge kept before it
+        size_t kept = 0;
+        for (size_t j = 0; j < nv->succs.size; j++) {
+            unsigned s = nv->succs.data[j];
+            uint64_t bit = 1ULL << (s % 64);
+            if (rv[s / 64] & bit) {
+                remove_idx(&g->nodes.data[s].preds, v);
+                (*removed)++;
+            }
+            else {
+                rv[s / 64] |= bit;
+                nv->succs.data[kept++] = s;
+            }
+        }
+        nv->succs.size = kept;
+    }
+    free(reach);
+    return 0;
+}
+
+int dag_build_reduced(dag *g, size_t *removed) {
+    assert(g != NULL);
+    assert(removed != NULL);
+    if (dag_build(g) != 0) {
+        return -1;
+    }
+    // no longest path uses a removed edge, so the levels and the
+    // order stay valid
+    return reduce(g, removed);
+}
+
+typedef struct number_key {
+    unsigned id;
+    unsigned key;
+    unsigned pos;
+} number_key;
+
+// larger keys first, then earlier in the topological order
+static int number_key_cmp(const void *a, const void *b) {
+    const number_key *ka = a;
+    const number_key *kb = b;
+    if (ka->key != kb->key) {
+        return (ka->key > kb->key) ? -1 : 1;
+    }
+    return (ka->pos > kb->pos) - (ka->pos < kb->pos);
+}
+
+// fills `by_new' with the vertices in their new order. Every order is
+// topological, so ids stay larger than the ids of their predecessors.
+static int number_order(dag *g, enum dag_numbering how, unsigned *by_new) {
+    size_t n = dag_size(g);
+    if (how == DAG_NUMBER_TOPO) {
+        memcpy(by_new, g->order, n * sizeof(*by_new));
+        return 0;
+    }
+    number_key *keys = malloc(n * sizeof(*keys));
+    unsigned *layers = calloc(n, sizeof(*layers));
+    if (keys == NULL || layers == NULL) {
+        free(keys);
+        free(layers);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        unsigned v = g->order[i];
+        node *nv = &g->nodes.data[v];
+        // the number of edges on the longest path from the source
+        for (size_t j = 0; j < nv->preds.size; j++) {
+            unsigned above = layers[nv->preds.data[j]] + 1;
+            layers[v] = (above > layers[v]) ? above : layers[v];
+        }
+        // earlier layers come first, as do higher levels
+        unsigned key = (how == DAG_NUMBER_LAYER) ? UINT_MAX - layers[v] :
+            nv->level;
+        keys[i] = (number_key) {.id = v, .key = key, .pos = i};
+    }
+    qsort(keys, n, sizeof(*keys), number_key_cmp);
+    for (size_t i = 0; i < n; i++) {
+        by_new[i] = keys[i].id;
+    }
+    free(layers);
+    free(keys);
+    return 0;
+}
+
+int dag_renumber(dag *g, enum dag_numbering how) {
+    assert(g != NULL);
+    assert(g->built);
+    size_t n = dag_size(g);
+    unsigned *by_new = malloc(n * sizeof(*by_new));
+    unsigned *new_ids = malloc(n * sizeof(*new_ids));
+    unsigned *input_ids = malloc(n * sizeof(*input_ids));
+    node *nodes = malloc(n * sizeof(*nodes));
+    if (by_new == NULL || new_ids == NULL || input_ids == NULL ||
+        nodes == NULL || number_order(g, how, by_new) != 0) {
+        free(by_new);
+        free(new_ids);
+        free(input_ids);
+        free(nodes);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        new_ids[by_new[i]] = i;
+    }
+    assert(new_ids[0] == 0 && new_ids[n - 1] == n - 1);
+
+    // move every node to its new place and rename its neighbours
+    for (size_t i = 0; i < n; i++) {
+        unsigned old = by_new[i];
+        nodes[i] = g->nodes.data[old];
+        for (size_t j = 0; j < nodes[i].preds.size; j++) {
+            nodes[i].preds.data[j] = new_ids[nodes[i].preds.data[j]];
+        }
+        for (size_t j = 0; j < nodes[i].succs.size; j++) {
+            nodes[i].succs.data[j] = new_ids[nodes[i].succs.data[j]];
+        }
+        input_ids[i] = (g->input_ids == NULL) ? old : g->input_ids[old];
+    }
+    for (size_t i = 0; i < n; i++) {
+        g->order[i] = new_ids[g->order[i]];
+    }
+    free(g->nodes.data);
+    g->nodes.data = nodes;
+    g->nodes.capacity = n;
+    free(g->input_ids);
+    g->input_ids = input_ids;
+    free(new_ids);
+    free(by_new);
+    return 0;
+}
+
+unsigned dag_input_id(dag *g, unsigned id) {
+    assert(g != NULL);
+    assert(id < dag_size(g));
+    return (g->input_ids == NULL) ? id : g->input_ids[id];
+}
+
 unsigned dag_source(dag *g) {
     assert(g != NULL);
     return 0;
@@ -229,3 +408,30 @@ int dag_level(dag *g, unsigned id) {
     assert(id < dag_size(g));
     return g->nodes.data[id].level;
 }
+
+const unsigned *dag_order(dag *g) {
+    assert(g != NULL);
+    assert(g->built);
+    return g->order;
+}
+
+static uint64_t fnv_word(uint64_t h, unsigned word) {
+    for (size_t b = 0; b < sizeof(word); b++) {
+        h = (h ^ ((word >> (8 * b)) & 0xff)) * FNV_PRIME;
+    }
+    return h;
+}
+
+uint64_t dag_hash(dag *g) {
+    assert(g != NULL);
+    uint64_t h = fnv_word(FNV_OFFSET, g->nodes.size);
+    for (size_t i = 0; i < g->nodes.size; i++) {
+        node *v = &g->nodes.data[i];
+        h = fnv_word(h, v->weight);
+        h = fnv_word(h, v->succs.size);
+        for (size_t j = 0; j < v->succs.size; j++) {
+            h = fnv_word(h, v->succs.data[j]);
+        }
+    }
+    return h;
+}
@@ -1,6 +1,8 @@
 #ifndef DAG_H
 #define DAG_H
 
+#include <stdint.h>
+
 struct dag;
 typedef struct dag dag;
 
@@ -23,6 +25,32 @@ unsigned dag_vertex(dag *g, int weight, size_t n, unsigned *n_deps);
 // otherwise.
 int dag_build(dag *g);
 
+// same as dag_build, but also removes every edge from u to v where v
+// can be reached from u through other vertices, which changes no
+// schedule. Stores the number of edges removed in `removed'. Can be
+// called on a dag that was already built. Returns 0 on success, -1
+// otherwise.
+int dag_build_reduced(dag *g, size_t *removed);
+
+// orders for dag_renumber: the topological order of dag_order, by
+// decreasing level, or by the number of edges on the longest path from
+// the source. Ties go to the vertex earlier in topological order.
+enum dag_numbering {
+    DAG_NUMBER_TOPO,
+    DAG_NUMBER_LEVEL,
+    DAG_NUMBER_LAYER,
+};
+
+// gives the vertices of the built dag new ids in the order `how', so
+// that sweeps over the vertices in that order touch memory in
+// sequence. The source and sink keep their ids and every vertex still
+// comes after its predecessors. Returns 0 on success, -1 otherwise.
+int dag_renumber(dag *g, enum dag_numbering how);
+
+// returns the id that was returned by dag_vertex for the vertex now
+// numbered `id'.
+unsigned dag_input_id(dag *g, unsigned id);
+
 // returns the id of the source (sink) vertex in the DAG.
 unsigned dag_source(dag *g);
 unsigned dag_sink(dag *g);
@@ -45,4 +73,13 @@ int dag_weight(dag *g, unsigned id);
 // only be called after dag_build.
 int dag_level(dag *g, unsigned id);
 
+// returns all vertices in topological order, starting with the
+// source. The array belongs to the dag and is only available after
+// dag_build.
+const unsigned *dag_order(dag *g);
+
+// returns a hash of the weights and successors of every vertex, which
+// is the same for dags built from the same input.
+uint64_t dag_hash(dag *g);
+
 #endif // DAG_H
@@ -0,0 +1,204 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DENSITY_X86
+#endif
+
+#include "density.h"
+
+typedef int (*density_fn)(const int32_t *, const int32_t *, const int32_t *,
+                          size_t, int, int);
+typedef int (*density16_fn)(const int16_t *, const int16_t *,
+                            const int16_t *, size_t, int, int);
+
+size_t density_padded(size_t n) {
+    return (n + DENSITY_PAD - 1) / DENSITY_PAD * DENSITY_PAD;
+}
+
+// A task can only be forced into [ci, cj] if it starts before cj and
+// ends after ci, in which case the forced part is positive. Otherwise
+// the minimum below is at most 0, so clamping at 0 replaces the test.
+#define DEFINE_DENSITY_SCALAR(NAME, TYPE)                               \
+    static int NAME(const TYPE *max_starts, const TYPE *min_ends,       \
+                    const TYPE *weights, size_t n, int ci, int cj) {    \
+        int density = 0;                                                \
+        for (size_t k = 0; k < n; k++) {                                \
+            int case1 = min_ends[k] - ci;                               \
+            int case2 = weights[k];                                     \
+            int case3 = cj - max_starts[k];                             \
+            int case4 = cj - ci;                                        \
+            int min1 = (case1 < case2) ? case1 : case2;                 \
+            int min2 = (case3 < case4) ? case3 : case4;                 \
+            int min = (min1 < min2) ? min1 : min2;                      \
+            density += (min > 0) ? min : 0;                             \
+        }                                                               \
+        return density;                                                 \
+    }
+
+DEFINE_DENSITY_SCALAR(density_scalar, int32_t);
+DEFINE_DENSITY_SCALAR(density16_scalar, int16_t);
+
+#ifdef DENSITY_X86
+__attribute__((target("sse4.1")))
+static int density_sse4(const int32_t *max_starts, const int32_t *min_ends,
+                        const int32_t *weights, size_t n, int ci, int cj) {
+    __m128i vci = _mm_set1_epi32(ci);
+    __m128i vcj = _mm_set1_epi32(cj);
+    __m128i vlen = _mm_set1_epi32(cj - ci);
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    for (size_t k = 0; k < n; k += 4) {
+        __m128i ends = _mm_loadu_si128((const __m128i *) (min_ends + k));
+        __m128i starts = _mm_loadu_si128((const __m128i *) (max_starts + k));
+        __m128i w = _mm_loadu_si128((const __m128i *) (weights + k));
+        __m128i min1 = _mm_min_epi32(_mm_sub_epi32(ends, vci), w);
+        __m128i min2 = _mm_min_epi32(_mm_sub_epi32(vcj, starts), vlen);
+        sum = _mm_add_epi32(sum, _mm_max_epi32(_mm_min_epi32(min1, min2),
+                                               zero));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2")))
+static int density_avx2(const int32_t *max_starts, const int32_t *min_ends,
+                        const int32_t *weights, size_t n, int ci, int cj) {
+    __m256i vci = _mm256_set1_epi32(ci);
+    __m256i vcj = _mm256_set1_epi32(cj);
+    __m256i vlen = _mm256_set1_epi32(cj - ci);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero;
+    for (size_t k = 0; k < n; k += 8) {
+        __m256i ends = _mm256_loadu_si256((const __m256i *) (min_ends + k));
+        __m256i starts =
+            _mm256_loadu_si256((const __m256i *) (max_starts + k));
+        __m256i w = _mm256_loadu_si256((const __m256i *) (weights + k));
+        __m256i min1 = _mm256_min_epi32(_mm256_sub_epi32(ends, vci), w);
+        __m256i min2 = _mm256_min_epi32(_mm256_sub_epi32(vcj, starts), vlen);
+        sum = _mm256_add_epi32(sum,
+                               _mm256_max_epi32(_mm256_min_epi32(min1, min2),
+                                                zero));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                 _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half,
+                         _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half,
+                         _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(half);
+}
+
+// Within the limits of work_density16 no difference or sum below
+// leaves 16 bits, so every lane can stay 16 bits wide until the
+// final sum.
+__attribute__((target("sse2")))
+static int density16_sse2(const int16_t *max_starts, const int16_t *min_ends,
+                          const int16_t *weights, size_t n, int ci, int cj) {
+    __m128i vci = _mm_set1_epi16(ci);
+    __m128i vcj = _mm_set1_epi16(cj);
+    __m128i vlen = _mm_set1_epi16(cj - ci);
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    for (size_t k = 0; k < n; k += 8) {
+        __m128i ends = _mm_loadu_si128((const __m128i *) (min_ends + k));
+        __m128i starts = _mm_loadu_si128((const __m128i *) (max_starts + k));
+        __m128i w = _mm_loadu_si128((const __m128i *) (weights + k));
+        __m128i min1 = _mm_min_epi16(_mm_sub_epi16(ends, vci), w);
+        __m128i min2 = _mm_min_epi16(_mm_sub_epi16(vcj, starts), vlen);
+        sum = _mm_add_epi16(sum, _mm_max_epi16(_mm_min_epi16(min1, min2),
+                                               zero));
+    }
+    // widen pairs of lanes to 32 bits before adding them up
+    sum = _mm_madd_epi16(sum, _mm_set1_epi16(1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2")))
+static int density16_avx2(const int16_t *max_starts, const int16_t *min_ends,
+                          const int16_t *weights, size_t n, int ci, int cj) {
+    __m256i vci = _mm256_set1_epi16(ci);
+    __m256i vcj = _mm256_set1_epi16(cj);
+    __m256i vlen = _mm256_set1_epi16(cj - ci);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero;
+    for (size_t k = 0; k < n; k += 16) {
+        __m256i ends = _mm256_loadu_si256((const __m256i *) (min_ends + k));
+        __m256i starts =
+            _mm256_loadu_si256((const __m256i *) (max_starts + k));
+        __m256i w = _mm256_loadu_si256((const __m256i *) (weights + k));
+        __m256i min1 = _mm256_min_epi16(_mm256_sub_epi16(ends, vci), w);
+        __m256i min2 = _mm256_min_epi16(_mm256_sub_epi16(vcj, starts), vlen);
+        sum = _mm256_add_epi16(sum,
+                               _mm256_max_epi16(_mm256_min_epi16(min1, min2),
+                                                zero));
+    }
+    sum = _mm256_madd_epi16(sum, _mm256_set1_epi16(1));
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                 _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half,
+                         _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half,
+                         _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(half);
+}
+#endif // DENSITY_X86
+
+static density16_fn density16_select(void) {
+#ifdef DENSITY_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return density16_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return density16_sse2;
+    }
+#endif
+    return density16_scalar;
+}
+
+static density_fn density_select(void) {
+#ifdef DENSITY_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return density_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return density_sse4;
+    }
+#endif
+    return density_scalar;
+}
+
+int work_density(const int32_t *max_starts, const int32_t *min_ends,
+                 const int32_t *weights, size_t n, int ci, int cj) {
+    // searches on several threads may race to select the kernel, but
+    // they all pick the same one
+    static _Atomic(density_fn) kernel = NULL;
+    density_fn fn = atomic_load_explicit(&kernel, memory_order_relaxed);
+    if (fn == NULL) {
+        fn = density_select();
+        atomic_store_explicit(&kernel, fn, memory_order_relaxed);
+    }
+    assert(n % DENSITY_PAD == 0);
+    return fn(max_starts, min_ends, weights, n, ci, cj);
+}
+
+int work_density16(const int16_t *max_starts, const int16_t *min_ends,
+                   const int16_t *weights, size_t n, int ci, int cj) {
+    static _Atomic(density16_fn) kernel = NULL;
+    density16_fn fn = atomic_load_explicit(&kernel, memory_order_relaxed);
+    if (fn == NULL) {
+        fn = density16_select();
+        atomic_store_explicit(&kernel, fn, memory_order_relaxed);
+    }
+    assert(n % DENSITY_PAD == 0);
+    assert(ci >= 0 && ci <= cj && cj <= DENSITY16_MAX);
+    return fn(max_starts, min_ends, weights, n, ci, cj);
+}
@@ -0,0 +1,31 @@
+#ifndef DENSITY_H
+#define DENSITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// arrays passed to work_density must be padded to a multiple of this
+// many elements. Padding must have zero weight.
+#define DENSITY_PAD (16)
+
+// the largest time, and the largest total weight, that work_density16
+// can handle.
+#define DENSITY16_MAX (16383)
+
+// returns `n' rounded up to a multiple of DENSITY_PAD.
+size_t density_padded(size_t n);
+
+// returns the total amount of work of `n' tasks that has to be done
+// within [ci, cj], given the latest start, earliest end and weight of
+// each task. Uses the widest vector instructions the CPU supports.
+int work_density(const int32_t *max_starts, const int32_t *min_ends,
+                 const int32_t *weights, size_t n, int ci, int cj);
+
+// same as work_density, but for 16-bit times and weights, which halves
+// the memory read and doubles the tasks handled per instruction. All
+// times must be in [0, DENSITY16_MAX] and the weights must add up to at
+// most DENSITY16_MAX.
+int work_density16(const int16_t *max_starts, const int16_t *min_ends,
+                   const int16_t *weights, size_t n, int ci, int cj);
+
+#endif // DENSITY_H
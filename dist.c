@@ -0,0 +1,569 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bbsearch.h"
+#include "dag.h"
+#include "parser.h"
+#include "vector.h"
+#include "dist.h"
+
+#define BACKLOG (64)
+
+// the search is split into at least this many subproblems, unless the
+// dag is too small for that
+#define MIN_SUBPROBLEMS (64)
+
+// the longest message line, which has to hold a whole prefix
+#define LINE_SIZE (65536)
+
+// how often, in milliseconds, a worker checks on its search. It looks
+// after 1 ms first and then twice as long each time up to this, so that
+// short subproblems are reported as soon as they are done.
+#define POLL_INTERVAL (100)
+
+// one end of a connection, with the bytes read but not yet handled.
+typedef struct conn {
+    int fd;
+    size_t len;
+    char buf[LINE_SIZE];
+    // the subproblem the worker is on, or -1
+    long task;
+    // whether the worker has the dag and can be given subproblems
+    int ready;
+} conn;
+
+// the subproblems: `count' prefixes of `len' tasks each, one after the
+// other in `tasks'.
+typedef struct split {
+    size_t count;
+    size_t len;
+    idx_vec tasks;
+} split;
+
+typedef struct ready_key {
+    unsigned id;
+    int level;
+    unsigned input_id;
+} ready_key;
+
+// tasks of higher level first, then in input order, as bbsearch
+// branches on them.
+static int ready_key_cmp(const void *a, const void *b) {
+    const ready_key *ka = a;
+    const ready_key *kb = b;
+    if (ka->level != kb->level) {
+        return (ka->level > kb->level) ? -1 : 1;
+    }
+    return (ka->input_id > kb->input_id) - (ka->input_id < kb->input_id);
+}
+
+// appends to `out' every prefix that extends `prefix' by one ready task.
+static int extend(dag *g, const unsigned *prefix, size_t len, idx_vec *out) {
+    size_t n = dag_size(g);
+    unsigned preds_left[n];
+    unsigned char done[n];
+    for (size_t i = 0; i < n; i++) {
+        preds_left[i] = dag_npreds(g, i);
+        done[i] = 0;
+    }
+    for (size_t k = 0; k <= len; k++) {
+        unsigned v = (k == 0) ? dag_source(g) : prefix[k - 1];
+        done[v] = 1;
+        size_t nsuccs = dag_nsuccs(g, v);
+        unsigned succs[nsuccs];
+        dag_succs(g, v, succs);
+        for (size_t i = 0; i < nsuccs; i++) {
+            preds_left[succs[i]]--;
+        }
+    }
+    ready_key keys[n];
+    size_t nready = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!done[i] && preds_left[i] == 0) {
+            keys[nready++] = (ready_key) {
+                .id = i,
+                .level = dag_level(g, i),
+                .input_id = dag_input_id(g, i),
+            };
+        }
+    }
+    qsort(keys, nready, sizeof(*keys), ready_key_cmp);
+    for (size_t r = 0; r < nready; r++) {
+        for (size_t k = 0; k < len; k++) {
+            if (idx_vec_push(out, prefix[k]) != 0) {
+                return -1;
+            }
+        }
+        if (idx_vec_push(out, keys[r].id) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// splits the search tree of `g' breadth first until there are at least
+// MIN_SUBPROBLEMS prefixes, or only the sink is left to schedule.
+static int split_create(dag *g, split *sp) {
+    sp->count = 1;
+    sp->len = 0;
+    if (idx_vec_init(&sp->tasks, 1) != 0) {
+        return -1;
+    }
+    while (sp->count < MIN_SUBPROBLEMS && sp->len + 3 < dag_size(g)) {
+        idx_vec next;
+        if (idx_vec_init(&next, 1) != 0) {
+            goto err;
+        }
+        for (size_t i = 0; i < sp->count; i++) {
+            if (extend(g, sp->tasks.data + i * sp->len, sp->len,
+                       &next) != 0) {
+                idx_vec_destroy(&next);
+                goto err;
+            }
+        }
+        idx_vec_destroy(&sp->tasks);
+        sp->tasks = next;
+        sp->len++;
+        sp->count = next.size / sp->len;
+    }
+    return 0;
+
+ err:
+    idx_vec_destroy(&sp->tasks);
+    return -1;
+}
+
+// reads what has arrived on `c'. Returns -1 once the other end has
+// hung up or the line is too long.
+static int conn_fill(conn *c) {
+    if (c->len == sizeof(c->buf)) {
+        return -1;
+    }
+    ssize_t got = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len);
+    if (got < 0 && errno == EINTR) {
+        return 0;
+    }
+    if (got <= 0) {
+        return -1;
+    }
+    c->len += got;
+    return 0;
+}
+
+// copies the next whole line read on `c' into `line', without the
+// newline. Returns 0 if there was one and -1 otherwise.
+static int conn_line(conn *c, char *line) {
+    char *end = memchr(c->buf, '\n', c->len);
+    if (end == NULL) {
+        return -1;
+    }
+    size_t n = end - c->buf;
+    memcpy(line, c->buf, n);
+    line[n] = '\0';
+    c->len -= n + 1;
+    memmove(c->buf, end + 1, c->len);
+    return 0;
+}
+
+// sends the whole of `msg', and returns 0 on success and -1 on failure.
+static int send_all(int fd, const char *msg, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(fd, msg, len, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        msg += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+// hands the next subproblem in `todo' to the worker on `c'.
+static int assign(conn *c, split *sp, idx_vec *todo, unsigned best) {
+    unsigned task;
+    if (idx_vec_pop(todo, &task) != 0) {
+        return 0;
+    }
+    char line[LINE_SIZE];
+    size_t len = snprintf(line, sizeof(line), "prefix %u %zu", best, sp->len);
+    for (size_t k = 0; k < sp->len && len < sizeof(line); k++) {
+        len += snprintf(line + len, sizeof(line) - len, " %u",
+                        sp->tasks.data[task * sp->len + k]);
+    }
+    if (len + 1 >= sizeof(line)) {
+        idx_vec_push(todo, task);
+        return -1;
+    }
+    line[len++] = '\n';
+    c->task = task;
+    return send_all(c->fd, line, len);
+}
+
+// sends the dag and the search parameters to a new worker.
+static int greet(int fd, dag *g, unsigned m, int timeout) {
+    int copy = dup(fd);
+    if (copy < 0) {
+        return -1;
+    }
+    FILE *out = fdopen(copy, "w");
+    if (out == NULL) {
+        close(copy);
+        return -1;
+    }
+    int err = fprintf(out, "%u %d\n", m, timeout) < 0;
+    err |= write_patterson(g, out) != 0;
+    err |= fclose(out) != 0;
+    return err ? -1 : 0;
+}
+
+// lowers `best' to `val' if that is shorter and passes it on to every
+// worker but `from'. Workers still reading the dag are left out, since
+// they read it through a buffer that could swallow the line, and get
+// `best' with their first subproblem instead.
+static void lower_best(conn **conns, size_t nconns, conn *from,
+                       unsigned *best, long val) {
+    if (val < 0 || (unsigned long) val >= *best) {
+        return;
+    }
+    *best = val;
+    char line[64];
+    int len = snprintf(line, sizeof(line), "bound %u\n", *best);
+    for (size_t j = 0; j < nconns; j++) {
+        if (conns[j] != from && conns[j]->ready) {
+            send_all(conns[j]->fd, line, len);
+        }
+    }
+}
+
+static int listen_on(const char *port) {
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+        .ai_flags = AI_PASSIVE,
+    };
+    struct addrinfo *addrs;
+    if (getaddrinfo(NULL, port, &hints, &addrs) != 0) {
+        return -1;
+    }
+    int sock = -1;
+    for (struct addrinfo *a = addrs; a != NULL && sock < 0; a = a->ai_next) {
+        sock = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (sock < 0) {
+            continue;
+        }
+        int on = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(sock, a->ai_addr, a->ai_addrlen) != 0 ||
+            listen(sock, BACKLOG) != 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(addrs);
+    return sock;
+}
+
+static int connect_to(const char *host, const char *port) {
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *addrs;
+    if (getaddrinfo(host, port, &hints, &addrs) != 0) {
+        return -1;
+    }
+    int sock = -1;
+    for (struct addrinfo *a = addrs; a != NULL && sock < 0; a = a->ai_next) {
+        sock = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (sock >= 0 && connect(sock, a->ai_addr, a->ai_addrlen) != 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(addrs);
+    return sock;
+}
+
+int dist_coordinate(dag *g, unsigned m, int timeout, const char *port) {
+    assert(g != NULL);
+    assert(m > 0);
+    assert(port != NULL);
+    int result = -1;
+    split sp;
+    if (split_create(g, &sp) != 0) {
+        goto err0;
+    }
+    // subproblems are handed out from the back, so the first is on top
+    idx_vec todo;
+    if (idx_vec_init(&todo, sp.count) != 0) {
+        goto err1;
+    }
+    for (size_t i = sp.count; i > 0; i--) {
+        idx_vec_push(&todo, i - 1);
+    }
+    int sock = listen_on(port);
+    if (sock < 0) {
+        perror("coordinate");
+        goto err2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    conn **conns = NULL;
+    size_t nconns = 0;
+    size_t left = sp.count;
+    unsigned best = UINT_MAX;
+    int timed_out = 0;
+    int failed = 0;
+    char line[LINE_SIZE];
+    while (left > 0 && !failed) {
+        struct pollfd fds[nconns + 1];
+        fds[0] = (struct pollfd) {.fd = sock, .events = POLLIN};
+        for (size_t i = 0; i < nconns; i++) {
+            fds[i + 1] = (struct pollfd) {.fd = conns[i]->fd,
+                                          .events = POLLIN};
+        }
+        if (poll(fds, nconns + 1, -1) < 0) {
+            continue;
+        }
+
+        // a worker that hangs up gives its subproblem back, and one
+        // that sends garbage is treated as if it had
+        for (size_t i = nconns; i > 0; i--) {
+            conn *c = conns[i - 1];
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            int gone = conn_fill(c) != 0;
+            while (!gone && conn_line(c, line) == 0) {
+                long val;
+                if (sscanf(line, "bound %ld", &val) == 1 && val >= 0) {
+                    lower_best(conns, nconns, c, &best, val);
+                }
+                else if (sscanf(line, "done %ld", &val) == 1 &&
+                         c->task >= 0) {
+                    // the last schedule the search found may only be
+                    // reported here
+                    lower_best(conns, nconns, c, &best, val);
+                    timed_out |= val == -2;
+                    failed |= val == -1;
+                    c->task = -1;
+                    left--;
+                }
+                else if (strcmp(line, "ready") == 0 && !c->ready) {
+                    c->ready = 1;
+                }
+                else {
+                    gone = 1;
+                }
+            }
+            if (gone) {
+                if (c->task >= 0 && idx_vec_push(&todo, c->task) != 0) {
+                    failed = 1;
+                }
+                close(c->fd);
+                free(c);
+                conns[i - 1] = conns[--nconns];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(sock, NULL, NULL);
+            if (fd < 0) {
+                continue;
+            }
+            conn *c = malloc(sizeof(*c));
+            conn **more = realloc(conns, (nconns + 1) * sizeof(*conns));
+            if (more != NULL) {
+                conns = more;
+            }
+            if (c == NULL || more == NULL || greet(fd, g, m, timeout) != 0) {
+                free(c);
+                close(fd);
+                continue;
+            }
+            *c = (conn) {.fd = fd, .len = 0, .task = -1, .ready = 0};
+            conns[nconns++] = c;
+        }
+
+        // including subproblems given back by workers that hung up
+        for (size_t i = nconns; i > 0 && todo.size > 0; i--) {
+            conn *c = conns[i - 1];
+            if (c->ready && c->task < 0 &&
+                assign(c, &sp, &todo, best) != 0) {
+                if (c->task >= 0 && idx_vec_push(&todo, c->task) != 0) {
+                    failed = 1;
+                }
+                close(c->fd);
+                free(c);
+                conns[i - 1] = conns[--nconns];
+            }
+        }
+    }
+    if (!failed) {
+        result = timed_out ? -2 : (int) best;
+    }
+
+    for (size_t i = 0; i < nconns; i++) {
+        send_all(conns[i]->fd, "quit\n", 5);
+        close(conns[i]->fd);
+        free(conns[i]);
+    }
+    free(conns);
+    close(sock);
+ err2:
+    idx_vec_destroy(&todo);
+ err1:
+    idx_vec_destroy(&sp.tasks);
+ err0:
+    return result;
+}
+
+// starts the search for the subproblem in `line'. Returns NULL if the
+// line is malformed or the search cannot be started.
+static bbjob *start(dag *g, unsigned m, int timeout, char *line,
+                    unsigned known) {
+    char *pos = line + strlen("prefix");
+    unsigned long upper = strtoul(pos, &pos, 10);
+    unsigned long len = strtoul(pos, &pos, 10);
+    if (len >= dag_size(g)) {
+        return NULL;
+    }
+    unsigned prefix[len + 1];
+    for (size_t k = 0; k < len; k++) {
+        char *end;
+        prefix[k] = strtoul(pos, &end, 10);
+        if (end == pos) {
+            return NULL;
+        }
+        pos = end;
+    }
+    upper = (known < upper) ? known : upper;
+    return bbsearch_start_prefix(g, m, timeout, prefix, len, upper);
+}
+
+int dist_work(const char *host, const char *port) {
+    assert(host != NULL);
+    assert(port != NULL);
+    int result = -1;
+    conn *c = malloc(sizeof(*c));
+    if (c == NULL) {
+        goto err0;
+    }
+    c->fd = connect_to(host, port);
+    if (c->fd < 0) {
+        perror("work");
+        goto err1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // the coordinator sends nothing after the dag until it hears that
+    // the dag was read, so the stream cannot read past it
+    int copy = dup(c->fd);
+    FILE *in = (copy < 0) ? NULL : fdopen(copy, "r");
+    if (in == NULL) {
+        if (copy >= 0) {
+            close(copy);
+        }
+        goto err2;
+    }
+    unsigned m;
+    int timeout;
+    dag *g = NULL;
+    int parsed = fscanf(in, "%u %d", &m, &timeout) == 2 && m > 0 &&
+        parse_patterson_stream(in, &g) == 0;
+    fclose(in);
+    if (!parsed) {
+        goto err2;
+    }
+    if (send_all(c->fd, "ready\n", 6) != 0) {
+        goto err3;
+    }
+
+    c->len = 0;
+    bbjob *job = NULL;
+    unsigned known = UINT_MAX;
+    int interval = 1;
+    char line[LINE_SIZE];
+    while (1) {
+        struct pollfd fds = {.fd = c->fd, .events = POLLIN};
+        int ready = poll(&fds, 1, (job != NULL) ? interval : -1);
+        interval = (2 * interval < POLL_INTERVAL) ?
+            2 * interval : POLL_INTERVAL;
+        int gone = 0;
+        if (ready > 0) {
+            gone = conn_fill(c) != 0;
+        }
+        while (!gone && conn_line(c, line) == 0) {
+            unsigned val;
+            if (strncmp(line, "prefix ", 7) == 0 && job == NULL) {
+                job = start(g, m, timeout, line, known);
+                gone = job == NULL;
+                interval = 1;
+            }
+            else if (sscanf(line, "bound %u", &val) == 1) {
+                known = (val < known) ? val : known;
+                if (job != NULL) {
+                    bbsearch_lower(job, known);
+                }
+            }
+            else if (strcmp(line, "quit") == 0) {
+                result = 0;
+                gone = 1;
+            }
+            else {
+                gone = 1;
+            }
+        }
+        if (gone) {
+            break;
+        }
+        if (job != NULL) {
+            unsigned incumbent;
+            int done = bbsearch_poll(job, &incumbent, NULL);
+            if (incumbent < known) {
+                known = incumbent;
+                int len = snprintf(line, sizeof(line), "bound %u\n", known);
+                gone = send_all(c->fd, line, len) != 0;
+            }
+            if (done) {
+                // the search may have finished with a shorter schedule
+                // since it was polled, which `done' carries
+                int found = bbsearch_join(job);
+                known = (found >= 0 && (unsigned) found < known) ?
+                    (unsigned) found : known;
+                int len = snprintf(line, sizeof(line), "done %d\n", found);
+                job = NULL;
+                gone |= send_all(c->fd, line, len) != 0;
+            }
+        }
+        if (gone) {
+            break;
+        }
+    }
+    if (job != NULL) {
+        bbsearch_cancel(job);
+        bbsearch_join(job);
+    }
+ err3:
+    dag_destroy(g);
+ err2:
+    close(c->fd);
+ err1:
+    free(c);
+ err0:
+    return result;
+}
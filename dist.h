@@ -0,0 +1,23 @@
+#ifndef DIST_H
+#define DIST_H
+
+#include "dag.h"
+
+// searches for the makespan of `g' on `m' machines with the help of
+// workers connecting to TCP port `port'. The search is split into
+// subproblems, each the schedules that start with a given order of
+// tasks, which are handed out one at a time to the workers. Workers
+// report every shorter schedule they find, and the coordinator passes
+// it on to all the others so they can prune against it. A subproblem
+// whose worker hangs up before finishing it is handed out again.
+// `timeout' applies to each subproblem separately. Returns what
+// bbsearch would once every subproblem is finished, or -1 if the port
+// cannot be listened on.
+int dist_coordinate(dag *g, unsigned m, int timeout, const char *port);
+
+// connects to the coordinator at `host' and `port' and solves the
+// subproblems it hands out until it has none left. Returns 0 once the
+// coordinator is finished and -1 on failure.
+int dist_work(const char *host, const char *port);
+
+#endif // DIST_H
@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dag.h"
+#include "generate.h"
+#include "parser.h"
+
+static const char *shapes[] = {
+    [GEN_LAYERED] = "layered",
+    [GEN_RANDOM] = "random",
+    [GEN_SERIES_PARALLEL] = "sp",
+    [GEN_FORK_JOIN] = "forkjoin",
+    [GEN_CHAIN] = "chain",
+};
+
+static const char *weights[] = {
+    [GEN_UNIFORM] = "uniform",
+    [GEN_EXPONENTIAL] = "exp",
+};
+
+// returns the index of `name' in `names', or -1 if it is not there.
+static int lookup(const char *name, const char **names, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-t layered|random|sp|forkjoin|chain] [-n tasks]\n"
+           "       [-d density] [-w width] [-r uniform|exp] [-l min weight]\n"
+           "       [-u max weight] [-s seed] [-o output file]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    gen_params p = {
+        .shape = GEN_LAYERED,
+        .n = 100,
+        .density = 0.3,
+        .width = 10,
+        .weights = GEN_UNIFORM,
+        .w_min = 1,
+        .w_max = 10,
+        .seed = 1,
+    };
+    const char *out = NULL;
+    int input_err = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:d:w:r:l:u:s:o:")) != -1) {
+        int idx;
+        switch (opt) {
+        case 't':
+            idx = lookup(optarg, shapes, sizeof(shapes) / sizeof(*shapes));
+            input_err |= idx < 0;
+            p.shape = idx;
+            break;
+        case 'n':
+            p.n = strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            p.density = atof(optarg);
+            break;
+        case 'w':
+            p.width = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            idx = lookup(optarg, weights, sizeof(weights) / sizeof(*weights));
+            input_err |= idx < 0;
+            p.weights = idx;
+            break;
+        case 'l':
+            p.w_min = atoi(optarg);
+            break;
+        case 'u':
+            p.w_max = atoi(optarg);
+            break;
+        case 's':
+            p.seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        default:
+            input_err = 1;
+        }
+    }
+    if (input_err || optind != argc || p.width == 0 || p.w_min < 0 ||
+        p.w_min > p.w_max) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    dag *g = generate(&p);
+    if (g == NULL) {
+        printf("Generation failed\n");
+        return 1;
+    }
+    FILE *f = (out == NULL) ? stdout : fopen(out, "w");
+    if (f == NULL) {
+        printf("Cannot open %s\n", out);
+        dag_destroy(g);
+        return 1;
+    }
+    int err = write_patterson(g, f);
+    if (f != stdout) {
+        err |= fclose(f);
+    }
+    dag_destroy(g);
+    if (err != 0) {
+        printf("Write failed\n");
+        return 1;
+    }
+    return 0;
+}
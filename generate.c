@@ -0,0 +1,233 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vector.h"
+#include "dag.h"
+#include "generate.h"
+
+uint64_t gen_next(gen_rng *rng) {
+    // splitmix64
+    uint64_t z = (rng->state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+double gen_uniform(gen_rng *rng) {
+    return (gen_next(rng) >> 11) * (1.0 / (1ULL << 53));
+}
+
+long gen_range(gen_rng *rng, long lo, long hi) {
+    assert(lo <= hi);
+    return lo + (long) (gen_next(rng) % (uint64_t) (hi - lo + 1));
+}
+
+static int weight(const gen_params *p, gen_rng *rng) {
+    if (p->weights == GEN_UNIFORM) {
+        return gen_range(rng, p->w_min, p->w_max);
+    }
+    double mean = (p->w_min + p->w_max) / 2.0;
+    long w = lround(-mean * log(1.0 - gen_uniform(rng)));
+    return (w < p->w_min) ? p->w_min : (w > p->w_max) ? p->w_max : w;
+}
+
+// adds a task depending on `deps'. Returns 0 on success and -1 on
+// failure.
+static int task(dag *g, const gen_params *p, gen_rng *rng, idx_vec *deps) {
+    unsigned id = dag_vertex(g, weight(p, rng), deps->size, deps->data);
+    return (id == (unsigned) -1) ? -1 : 0;
+}
+
+static int layered(dag *g, const gen_params *p, gen_rng *rng,
+                   idx_vec *deps) {
+    for (size_t k = 0; k < p->n; k++) {
+        deps->size = 0;
+        size_t layer = k / p->width;
+        if (layer > 0) {
+            size_t first = (layer - 1) * p->width;
+            for (size_t j = first; j < first + p->width; j++) {
+                if (gen_uniform(rng) < p->density &&
+                    idx_vec_push(deps, j + 1) != 0) {
+                    return -1;
+                }
+            }
+            // every task below the first layer has a predecessor in
+            // the layer above it
+            if (deps->size == 0 &&
+                idx_vec_push(deps, first + 1 +
+                             gen_range(rng, 0, p->width - 1)) != 0) {
+                return -1;
+            }
+        }
+        if (task(g, p, rng, deps) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int random_order(dag *g, const gen_params *p, gen_rng *rng,
+                        idx_vec *deps) {
+    for (size_t k = 0; k < p->n; k++) {
+        deps->size = 0;
+        for (size_t j = 0; j < k; j++) {
+            if (gen_uniform(rng) < p->density &&
+                idx_vec_push(deps, j + 1) != 0) {
+                return -1;
+            }
+        }
+        if (task(g, p, rng, deps) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// adds `n' tasks that all come after `in', pushing the ones without
+// successors to `out'.
+static int series_parallel(dag *g, const gen_params *p, gen_rng *rng,
+                           size_t n, idx_vec *in, idx_vec *out) {
+    if (n == 1) {
+        unsigned id = dag_vertex(g, weight(p, rng), in->size, in->data);
+        if (id == (unsigned) -1) {
+            return -1;
+        }
+        return idx_vec_push(out, id);
+    }
+    if (p->width < 2 || gen_uniform(rng) < p->density) {
+        size_t first = gen_range(rng, 1, n - 1);
+        idx_vec mid;
+        if (idx_vec_init(&mid, 1) != 0) {
+            return -1;
+        }
+        int err = series_parallel(g, p, rng, first, in, &mid);
+        if (err == 0) {
+            err = series_parallel(g, p, rng, n - first, &mid, out);
+        }
+        idx_vec_destroy(&mid);
+        return err;
+    }
+    // split the tasks between the branches, at least one each
+    size_t nbranches = gen_range(rng, 2, (n < p->width) ? n : p->width);
+    size_t left = n - nbranches;
+    for (size_t b = 0; b < nbranches; b++) {
+        size_t extra = (b == nbranches - 1) ? left : gen_range(rng, 0, left);
+        left -= extra;
+        if (series_parallel(g, p, rng, 1 + extra, in, out) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int fork_join(dag *g, const gen_params *p, gen_rng *rng,
+                     idx_vec *deps) {
+    deps->size = 0;
+    size_t left = p->n;
+    while (left > 0) {
+        unsigned fork = dag_vertex(g, weight(p, rng), deps->size, deps->data);
+        if (fork == (unsigned) -1) {
+            return -1;
+        }
+        left--;
+        size_t nbranches = (left < 2) ? left :
+            (left - 1 < p->width) ? left - 1 : p->width;
+        deps->size = 0;
+        for (size_t b = 0; b < nbranches; b++) {
+            unsigned id = dag_vertex(g, weight(p, rng), 1, &fork);
+            if (id == (unsigned) -1 || idx_vec_push(deps, id) != 0) {
+                return -1;
+            }
+        }
+        left -= nbranches;
+        if (left == 0) {
+            break;
+        }
+        unsigned join = dag_vertex(g, weight(p, rng), deps->size, deps->data);
+        if (join == (unsigned) -1) {
+            return -1;
+        }
+        left--;
+        deps->size = 0;
+        if (idx_vec_push(deps, join) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int chain(dag *g, const gen_params *p, gen_rng *rng, idx_vec *deps) {
+    size_t nchains = (p->width < p->n) ? p->width : p->n;
+    for (size_t k = 0; k < p->n; k++) {
+        deps->size = 0;
+        if (k >= nchains) {
+            size_t above = k - nchains;
+            size_t c = k % nchains;
+            size_t beside = above - c + (c + 1) % nchains;
+            if (idx_vec_push(deps, above + 1) != 0) {
+                return -1;
+            }
+            if (beside != above && gen_uniform(rng) < p->density &&
+                idx_vec_push(deps, beside + 1) != 0) {
+                return -1;
+            }
+        }
+        if (task(g, p, rng, deps) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+dag *generate(const gen_params *p) {
+    assert(p != NULL);
+    assert(p->width > 0);
+    assert(p->w_min <= p->w_max);
+    gen_rng rng = {.state = p->seed};
+    dag *g = dag_create();
+    if (g == NULL) {
+        goto err0;
+    }
+    idx_vec deps;
+    if (idx_vec_init(&deps, 1) != 0) {
+        goto err1;
+    }
+    int err = 0;
+    switch (p->shape) {
+    case GEN_LAYERED:
+        err = layered(g, p, &rng, &deps);
+        break;
+    case GEN_RANDOM:
+        err = random_order(g, p, &rng, &deps);
+        break;
+    case GEN_SERIES_PARALLEL:
+        if (p->n > 0) {
+            idx_vec out;
+            if (idx_vec_init(&out, 1) != 0) {
+                err = -1;
+                break;
+            }
+            err = series_parallel(g, p, &rng, p->n, &deps, &out);
+            idx_vec_destroy(&out);
+        }
+        break;
+    case GEN_FORK_JOIN:
+        err = fork_join(g, p, &rng, &deps);
+        break;
+    case GEN_CHAIN:
+        err = chain(g, p, &rng, &deps);
+        break;
+    }
+    idx_vec_destroy(&deps);
+    if (err != 0 || dag_build(g) != 0) {
+        goto err1;
+    }
+    return g;
+
+ err1:
+    dag_destroy(g);
+ err0:
+    return NULL;
+}
@@ -0,0 +1,67 @@
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "dag.h"
+
+enum gen_shape {
+    // `width' tasks per layer, each depending on tasks of the layer
+    // before it with probability `density'
+    GEN_LAYERED,
+    // each task depends on every earlier task with probability
+    // `density'
+    GEN_RANDOM,
+    // built by nesting series and parallel compositions, choosing
+    // series with probability `density', with at most `width' branches
+    // in each parallel composition
+    GEN_SERIES_PARALLEL,
+    // a fork task, `width' independent tasks and a join task, repeated
+    GEN_FORK_JOIN,
+    // `width' long chains, with an edge between neighbouring chains
+    // with probability `density' at each step
+    GEN_CHAIN,
+};
+
+enum gen_weights {
+    // weights drawn uniformly from [w_min, w_max]
+    GEN_UNIFORM,
+    // weights drawn from an exponential distribution with mean
+    // (w_min + w_max) / 2, clamped to [w_min, w_max]
+    GEN_EXPONENTIAL,
+};
+
+typedef struct gen_params {
+    enum gen_shape shape;
+    // number of tasks, not counting the source and sink
+    size_t n;
+    double density;
+    size_t width;
+    enum gen_weights weights;
+    int w_min;
+    int w_max;
+    uint64_t seed;
+} gen_params;
+
+// returns a new built dag with the shape and weights described by
+// `p', or NULL on failure. The same parameters always give the same
+// dag.
+dag *generate(const gen_params *p);
+
+// a small pseudo random number generator that gives the same numbers
+// on every platform. Seed it by setting the state to any value.
+typedef struct gen_rng {
+    uint64_t state;
+} gen_rng;
+
+// returns the next number from `rng', uniform over all 64-bit values.
+uint64_t gen_next(gen_rng *rng);
+
+// returns a number uniform in [0, 1).
+double gen_uniform(gen_rng *rng);
+
+// returns a number uniform in [lo, hi].
+long gen_range(gen_rng *rng, long lo, long hi);
+
+#endif // GENERATE_H
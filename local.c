@@ -0,0 +1,242 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "binheap.h"
+#include "dag.h"
+#include "generate.h"
+#include "schedule.h"
+#include "local.h"
+
+// the timeout is only looked at every CHECK_INTERVAL moves, which must
+// be a power of two.
+#define CHECK_INTERVAL (64)
+
+typedef struct local_state {
+    dag *g;
+    schedule *s;
+    size_t n;
+    // the order the tasks are added in, and the place of each task in it
+    unsigned *order;
+    unsigned *pos;
+} local_state;
+
+static double thread_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// fills `order' with the tasks of `g', taking the ready task of highest
+// level each time.
+static int initial_order(dag *g, unsigned *order) {
+    size_t n = dag_size(g);
+    unsigned *preds_left = malloc(n * sizeof(*preds_left));
+    binheap *ready = binheap_create();
+    if (preds_left == NULL || ready == NULL) {
+        goto err;
+    }
+    for (size_t i = 0; i < n; i++) {
+        preds_left[i] = dag_npreds(g, i);
+    }
+    if (binheap_put(ready, dag_source(g), dag_level(g, dag_source(g))) != 0) {
+        goto err;
+    }
+    for (size_t k = 0; k < n; k++) {
+        unsigned v = binheap_get(ready);
+        assert(v != (unsigned) -1);
+        order[k] = v;
+        size_t nsuccs = dag_nsuccs(g, v);
+        unsigned succs[nsuccs];
+        dag_succs(g, v, succs);
+        for (size_t i = 0; i < nsuccs; i++) {
+            if (--preds_left[succs[i]] == 0 &&
+                binheap_put(ready, succs[i], dag_level(g, succs[i])) != 0) {
+                goto err;
+            }
+        }
+    }
+    binheap_destroy(ready);
+    free(preds_left);
+    return 0;
+
+ err:
+    if (ready != NULL) {
+        binheap_destroy(ready);
+    }
+    free(preds_left);
+    return -1;
+}
+
+// places the tasks again from place `from' on, keeping the schedule of
+// the tasks before it. Gives up as soon as the schedule is longer than
+// `limit'. Returns 0 if the schedule is complete, 1 if it gave up and
+// -1 on error.
+static int replay(local_state *st, size_t from, unsigned limit) {
+    while (schedule_size(st->s) > from) {
+        schedule_pop(st->s);
+    }
+    for (size_t k = schedule_size(st->s); k < st->n; k++) {
+        if (schedule_add(st->s, st->order[k]) != 0) {
+            return -1;
+        }
+        if (schedule_length(st->s) > limit) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// moves the task at place `i' to place `j', shifting the tasks in
+// between.
+static void move_task(local_state *st, size_t i, size_t j) {
+    unsigned v = st->order[i];
+    if (i < j) {
+        memmove(st->order + i, st->order + i + 1,
+                (j - i) * sizeof(*st->order));
+    }
+    else {
+        memmove(st->order + j + 1, st->order + j,
+                (i - j) * sizeof(*st->order));
+    }
+    st->order[j] = v;
+    size_t lo = (i < j) ? i : j;
+    size_t hi = (i < j) ? j : i;
+    for (size_t k = lo; k <= hi; k++) {
+        st->pos[st->order[k]] = k;
+    }
+}
+
+// stores in `lo' and `hi' the first and last place the task at place
+// `i' can be moved to without coming before a predecessor or after a
+// successor.
+static void move_range(local_state *st, size_t i, size_t *lo, size_t *hi) {
+    unsigned v = st->order[i];
+    size_t npreds = dag_npreds(st->g, v);
+    size_t nsuccs = dag_nsuccs(st->g, v);
+    unsigned preds[npreds];
+    unsigned succs[nsuccs];
+    dag_preds(st->g, v, preds);
+    dag_succs(st->g, v, succs);
+    *lo = 0;
+    for (size_t k = 0; k < npreds; k++) {
+        *lo = (st->pos[preds[k]] + 1 > *lo) ? st->pos[preds[k]] + 1 : *lo;
+    }
+    *hi = st->n - 1;
+    for (size_t k = 0; k < nsuccs; k++) {
+        *hi = (st->pos[succs[k]] - 1 < *hi) ? st->pos[succs[k]] - 1 : *hi;
+    }
+}
+
+int local_search(dag *g, unsigned m, double timeout, unsigned long moves,
+                 uint64_t seed, unsigned *order) {
+    assert(g != NULL);
+    assert(m > 0);
+    assert(timeout >= 0 || moves > 0);
+    int result = -1;
+    local_state st = {.g = g, .n = dag_size(g)};
+    st.s = schedule_create_decoder(g, m);
+    if (st.s == NULL) {
+        goto err0;
+    }
+    st.order = malloc(st.n * sizeof(*st.order));
+    st.pos = malloc(st.n * sizeof(*st.pos));
+    unsigned *best_order = malloc(st.n * sizeof(*best_order));
+    if (st.order == NULL || st.pos == NULL || best_order == NULL) {
+        goto err1;
+    }
+    if (initial_order(g, st.order) != 0) {
+        goto err1;
+    }
+    for (size_t k = 0; k < st.n; k++) {
+        st.pos[st.order[k]] = k;
+    }
+    if (replay(&st, 0, UINT_MAX) != 0) {
+        goto err1;
+    }
+    unsigned cur = schedule_length(st.s);
+    unsigned best = cur;
+    memcpy(best_order, st.order, st.n * sizeof(*best_order));
+
+    // no schedule is shorter than the critical path or the work spread
+    // over all machines
+    unsigned total_work = 0;
+    for (size_t i = 0; i < st.n; i++) {
+        total_work += dag_weight(g, i);
+    }
+    unsigned floor_bound = total_work / m + (total_work % m != 0);
+    if (dag_level(g, dag_source(g)) > floor_bound) {
+        floor_bound = dag_level(g, dag_source(g));
+    }
+
+    // the temperature falls linearly from the mean task weight to 0
+    // over the moves or the time allowed, whichever runs out first
+    double start_temp = (double) total_work / st.n;
+    double start_time = thread_time();
+    double progress = 0;
+    gen_rng rng = {.state = seed};
+    for (unsigned long move = 0; best > floor_bound && st.n > 3; move++) {
+        if (moves > 0) {
+            progress = (double) move / moves;
+        }
+        if (timeout >= 0 && (move & (CHECK_INTERVAL - 1)) == 0) {
+            double elapsed = (timeout > 0) ?
+                (thread_time() - start_time) / timeout : 1;
+            progress = (elapsed > progress) ? elapsed : progress;
+        }
+        if (progress >= 1) {
+            break;
+        }
+
+        // the source and sink never move
+        size_t i = gen_range(&rng, 1, st.n - 2);
+        size_t lo, hi;
+        move_range(&st, i, &lo, &hi);
+        if (lo == hi) {
+            continue;
+        }
+        size_t j = gen_range(&rng, lo, hi - 1);
+        j += (j >= i);
+
+        // decide how much longer the schedule may get before placing
+        // it, so that placing can stop as soon as it is too long
+        double temp = start_temp * (1 - progress);
+        double slack = -temp * log(1 - gen_uniform(&rng));
+        unsigned limit = (slack < UINT_MAX - cur) ? cur + slack : UINT_MAX;
+        move_task(&st, i, j);
+        size_t from = (i < j) ? i : j;
+        int err = replay(&st, from, limit);
+        if (err < 0) {
+            goto err1;
+        }
+        if (err > 0) {
+            move_task(&st, j, i);
+            if (replay(&st, from, UINT_MAX) != 0) {
+                goto err1;
+            }
+            continue;
+        }
+        cur = schedule_length(st.s);
+        if (cur < best) {
+            best = cur;
+            memcpy(best_order, st.order, st.n * sizeof(*best_order));
+        }
+    }
+    if (order != NULL) {
+        memcpy(order, best_order, st.n * sizeof(*order));
+    }
+    result = best;
+
+ err1:
+    free(best_order);
+    free(st.pos);
+    free(st.order);
+    schedule_destroy(st.s);
+ err0:
+    return result;
+}
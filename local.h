@@ -0,0 +1,22 @@
+#ifndef LOCAL_H
+#define LOCAL_H
+
+#include <stdint.h>
+
+#include "dag.h"
+
+// looks for a short schedule of `g' on `m' machines among the orders
+// in which schedule_add can be given the tasks, by simulated annealing
+// from the order that adds the ready task of highest level first. A
+// move takes one task to another place between its predecessors and
+// successors, and only the part of the schedule from the first task
+// moved onwards is placed again. Stops after `timeout' seconds of CPU
+// time or `moves' moves, whichever comes first, and ignores `timeout'
+// if it is negative and `moves' if it is 0. The same seed and number
+// of moves always give the same schedule. Stores the best order found
+// in `order' unless it is NULL, and returns its makespan, or -1 on
+// error.
+int local_search(dag *g, unsigned m, double timeout, unsigned long moves,
+                 uint64_t seed, unsigned *order);
+
+#endif // LOCAL_H
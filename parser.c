@@ -13,62 +13,131 @@ int parse_patterson(const char *fp, dag **ret_g) {
     if (f == NULL) {
         return -1;
     }
+    int err = parse_patterson_stream(f, ret_g);
+    fclose(f);
+    return err;
+}
 
+int parse_patterson_stream(FILE *f, dag **ret_g) {
     int n_nodes;
     int n_resources;
-    fscanf(f, "%d %d", &n_nodes, &n_resources);
+    if (fscanf(f, "%d %d", &n_nodes, &n_resources) != 2) {
+        fprintf(stderr, "Missing number of vertices\n");
+        return -1;
+    }
 
     if (n_resources != 0) {
         fprintf(stderr, "Resource constrained problems not supported\n");
-        fclose(f);
         return -1;
     }
-    if (n_nodes < 0) {
+    if (n_nodes < 2) {
         fprintf(stderr, "Illegal number of vertices specified\n");
-        fclose(f);
         return -1;
     }
 
-    unsigned node_lens[n_nodes];
-    idx_vec node_preds[n_nodes];
-    for (size_t i = 0; i < n_nodes; i++) {
-        if (idx_vec_init(&node_preds[i], 0) != 0) {
-            return -1;
-        }
+    // the number of vertices comes from the input, so nothing is
+    // allocated for a vertex before its line has been read
+    int result = -1;
+    idx_vec lens;
+    idx_vec edges;
+    if (idx_vec_init(&lens, 1) != 0) {
+        goto err0;
+    }
+    if (idx_vec_init(&edges, 1) != 0) {
+        goto err1;
     }
 
-    // read data lines
-    for (size_t i = 0; i < n_nodes; i++) {
+    // read data lines, keeping each edge as its head and then its tail
+    int err = 0;
+    for (size_t i = 0; i < n_nodes && err == 0; i++) {
+        unsigned len;
         int n_succs;
-        fscanf(f, "%d %d", &node_lens[i], &n_succs);
-        for (size_t j = 0; j < n_succs; j++) {
+        if (fscanf(f, "%u %d", &len, &n_succs) != 2 || n_succs < 0 ||
+            idx_vec_push(&lens, len) != 0) {
+            err = -1;
+        }
+        for (size_t j = 0; j < n_succs && err == 0; j++) {
             unsigned succ_id;
-            fscanf(f, "%d", &succ_id);
-            succ_id--;
-            if (succ_id > 0) {
-                idx_vec_push(&node_preds[succ_id], i);
+            if (fscanf(f, "%u", &succ_id) != 1 || succ_id <= i + 1 ||
+                succ_id > n_nodes) {
+                err = -1;
+            }
+            else if (idx_vec_push(&edges, succ_id - 1) != 0 ||
+                     idx_vec_push(&edges, i) != 0) {
+                err = -1;
             }
         }
     }
+    if (err != 0) {
+        fprintf(stderr, "Malformed vertex line\n");
+        goto err2;
+    }
 
-    fclose(f);
+    // group the tails by head, keeping them in input order, so that
+    // the predecessors of vertex i are preds[first[i]] up to
+    // preds[first[i + 1]]
+    size_t n_edges = edges.size / 2;
+    size_t *first = calloc(n_nodes + 1, sizeof(*first));
+    unsigned *preds = malloc((n_edges + 1) * sizeof(*preds));
+    if (first == NULL || preds == NULL) {
+        goto err3;
+    }
+    for (size_t e = 0; e < n_edges; e++) {
+        first[edges.data[2 * e]]++;
+    }
+    // turn the counts into the ends of the groups, then fill each group
+    // from its end
+    for (size_t i = 1; i <= n_nodes; i++) {
+        first[i] += first[i - 1];
+    }
+    for (size_t e = n_edges; e-- > 0;) {
+        preds[--first[edges.data[2 * e]]] = edges.data[2 * e + 1];
+    }
 
     dag *g = dag_create();
     if (g == NULL) {
-        return -1;
+        goto err3;
     }
-
-    for (size_t i = 1; i < n_nodes - 1; i++) {
-        dag_vertex(g, node_lens[i], node_preds[i].size, node_preds[i].data);
+    for (size_t i = 1; i < n_nodes - 1 && err == 0; i++) {
+        err = dag_vertex(g, lens.data[i], first[i + 1] - first[i],
+                         preds + first[i]) == (unsigned) -1;
     }
-
-    for (size_t i = 0; i < n_nodes; i++) {
-        idx_vec_destroy(&node_preds[i]);
+    if (err != 0 || dag_build(g) != 0) {
+        dag_destroy(g);
+        goto err3;
     }
-
-    dag_build(g);
     *ret_g = g;
-    return 0;
+    result = 0;
+
+ err3:
+    free(preds);
+    free(first);
+ err2:
+    idx_vec_destroy(&edges);
+ err1:
+    idx_vec_destroy(&lens);
+ err0:
+    return result;
+}
+
+int write_patterson(dag *g, FILE *f) {
+    assert(g != NULL);
+    assert(f != NULL);
+    // the source is the first vertex and the sink the last, as the
+    // format requires
+    size_t size = dag_size(g);
+    int err = fprintf(f, "%4zu %4d\n\n\n", size, 0) < 0;
+    for (size_t i = 0; i < size && !err; i++) {
+        size_t nsuccs = dag_nsuccs(g, i);
+        unsigned succs[nsuccs];
+        dag_succs(g, i, succs);
+        err |= fprintf(f, "%4d %3zu", dag_weight(g, i), nsuccs) < 0;
+        for (size_t j = 0; j < nsuccs; j++) {
+            err |= fprintf(f, " %u", succs[j] + 1) < 0;
+        }
+        err |= fprintf(f, "\n") < 0;
+    }
+    return err ? -1 : 0;
 }
 
 void print_dot(dag *g, const char *name) {
@@ -1,12 +1,22 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stdio.h>
+
 #include "dag.h"
 
 // read and parse the given Patterson data file. Store the resulting
 // dag in `g'. Return 0 on success and -1 on failure.
 int parse_patterson(const char *fp, dag **g);
 
+// same as parse_patterson, but reads the data from `f', stopping after
+// the last vertex line.
+int parse_patterson_stream(FILE *f, dag **g);
+
+// write the built dag `g' to `f' in the Patterson data format. Return
+// 0 on success and -1 on failure.
+int write_patterson(dag *g, FILE *f);
+
 void print_dot(dag *g, const char *name);
 
 #endif // PARSER_H
@@ -1,24 +1,174 @@
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "vector.h"
 #include "bitmap.h"
-#include "binheap.h"
+#include "density.h"
 #include "schedule.h"
 
+// bucket event times directly as long as the largest one is at most
+// this many times the number of events
+#define COUNTING_SLACK 8
+
+// everything schedule_add changes besides the min_ends, so that
+// schedule_pop can put it back
+typedef struct placement {
+    unsigned machine;
+    unsigned machine_end;
+    unsigned length;
+    unsigned path_bound;
+    unsigned min_free;
+    unsigned free_m;
+    size_t trail_size;
+} placement;
+
+DECLARE_VECTOR(place_vec, placement);
+DEFINE_VECTOR(place_vec, placement);
+
+// a min_end overwritten by schedule_add
+typedef struct trail_entry {
+    unsigned idx;
+    unsigned min_end;
+} trail_entry;
+
+DECLARE_VECTOR(trail_vec, trail_entry);
+DEFINE_VECTOR(trail_vec, trail_entry);
+
+// the time windows of the unscheduled tasks for one horizon, and the
+// times the density bounds are tried at. Every schedule has one for
+// schedule_build, and schedule_probe_create makes more so that several
+// horizons can be tried at once.
+struct schedule_probe {
+    unsigned total_time;
+    // the windows and weights in order of decreasing level, padded with
+    // zero weights for the density kernel. The 16-bit copies are NULL
+    // if the total work is too large for them, and used instead if
+    // `narrow' is set.
+    size_t nresidual;
+    int32_t *max_starts;
+    int32_t *min_ends;
+    int32_t *weights;
+    int16_t *max_starts16;
+    int16_t *min_ends16;
+    int16_t *weights16;
+    int narrow;
+    idx_vec comp_list;
+    // the work done by scheduled tasks before each time in comp_list
+    unsigned *comp_busy;
+};
+
 struct schedule {
     idx_vec order;
     bitmap* contents;
     dag *g;
     unsigned m;
     unsigned length;
-    unsigned *max_starts;
+    unsigned work;
+    unsigned total_work;
+    unsigned path_bound;
+    unsigned min_free;
+    unsigned free_m;
+    unsigned *machine_ends;
+    unsigned *task_ends;
+    unsigned *assignments;
+    unsigned *preds_left;
+    place_vec placements;
     unsigned *min_ends;
+    // whether schedule_add keeps the min_ends up to date
+    int keep_min_ends;
+    trail_vec trail;
+    idx_vec changed;
+    unsigned total_time;
+    unsigned *by_level;
+    // the unscheduled tasks in order of decreasing level, linked
+    // through their positions in by_level. Position n is the head.
+    unsigned *level_pos;
+    unsigned *level_next;
+    unsigned *level_prev;
+    idx_vec fixed_times;
+    // the work done by scheduled tasks before each fixed time, and how
+    // many of them run from it to the next one
+    unsigned *fixed_busy;
+    unsigned *fixed_running;
+    int fixed_valid;
+    schedule_probe window;
+    unsigned char *marks;
+    size_t nmarks;
+    unsigned *scratch;
 };
 
+// fill `buf' with all vertices in order of decreasing level.
+static int sort_by_level(dag *g, unsigned *buf) {
+    size_t n = dag_size(g);
+    unsigned max_level = dag_level(g, dag_source(g));
+    unsigned *counts = calloc(max_level + 2, sizeof(*counts));
+    if (counts == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        counts[max_level - dag_level(g, i) + 1]++;
+    }
+    for (size_t l = 1; l < max_level + 2; l++) {
+        counts[l] += counts[l - 1];
+    }
+    for (size_t i = 0; i < n; i++) {
+        buf[counts[max_level - dag_level(g, i)]++] = i;
+    }
+    free(counts);
+    return 0;
+}
+
+static void probe_destroy(schedule_probe *p) {
+    free(p->max_starts);
+    free(p->min_ends);
+    free(p->weights);
+    free(p->max_starts16);
+    free(p->min_ends16);
+    free(p->weights16);
+    free(p->comp_busy);
+    idx_vec_destroy(&p->comp_list);
+}
+
+// set up `p' for the tasks of `s', whose total work must be known.
+// Cleans up after itself on failure.
+static int probe_init(schedule *s, schedule_probe *p) {
+    size_t n = dag_size(s->g);
+    size_t padded = density_padded(n);
+    if (idx_vec_init(&p->comp_list, 2 * n) != 0) {
+        return -1;
+    }
+    p->max_starts = calloc(padded, sizeof(*p->max_starts));
+    p->min_ends = calloc(padded, sizeof(*p->min_ends));
+    p->weights = calloc(padded, sizeof(*p->weights));
+    p->max_starts16 = NULL;
+    p->min_ends16 = NULL;
+    p->weights16 = NULL;
+    p->comp_busy = malloc(2 * n * sizeof(*p->comp_busy));
+    int failed = p->max_starts == NULL || p->min_ends == NULL ||
+        p->weights == NULL || p->comp_busy == NULL;
+    // no time in a schedule is later than the total work, so small
+    // enough dags can use the narrow density kernel
+    if (s->total_work <= DENSITY16_MAX) {
+        p->max_starts16 = calloc(padded, sizeof(*p->max_starts16));
+        p->min_ends16 = calloc(padded, sizeof(*p->min_ends16));
+        p->weights16 = calloc(padded, sizeof(*p->weights16));
+        failed |= p->max_starts16 == NULL || p->min_ends16 == NULL ||
+            p->weights16 == NULL;
+    }
+    if (failed) {
+        probe_destroy(p);
+        return -1;
+    }
+    p->total_time = 0;
+    p->nresidual = 0;
+    p->narrow = 0;
+    return 0;
+}
+
 schedule *schedule_create(dag *g, unsigned m) {
     assert(g != NULL);
     assert(m > 0);
@@ -26,27 +176,145 @@ schedule *schedule_create(dag *g, unsigned m) {
     if (s == NULL) {
         return NULL;
     }
-    if (idx_vec_init(&s->order, 0) != 0) {
-        free(s);
-        return NULL;
+    size_t n = dag_size(g);
+    if (idx_vec_init(&s->order, n) != 0) {
+        goto err1;
     }
-    s->contents = bitmap_create(0);
+    s->contents = bitmap_create(n);
     if (s->contents == NULL) {
-        idx_vec_destroy(&s->order);
-        return NULL;
+        goto err2;
+    }
+    if (place_vec_init(&s->placements, n) != 0) {
+        goto err3;
+    }
+    if (trail_vec_init(&s->trail, n) != 0) {
+        goto err4;
+    }
+    if (idx_vec_init(&s->changed, n) != 0) {
+        goto err5;
+    }
+    if (idx_vec_init(&s->fixed_times, 2 * n) != 0) {
+        goto err6;
+    }
+    s->machine_ends = calloc(m, sizeof(*s->machine_ends));
+    s->task_ends = calloc(n, sizeof(*s->task_ends));
+    s->assignments = calloc(n, sizeof(*s->assignments));
+    s->preds_left = malloc(n * sizeof(*s->preds_left));
+    s->min_ends = calloc(n, sizeof(*s->min_ends));
+    s->by_level = malloc(n * sizeof(*s->by_level));
+    s->level_pos = malloc(n * sizeof(*s->level_pos));
+    s->level_next = malloc((n + 1) * sizeof(*s->level_next));
+    s->level_prev = malloc((n + 1) * sizeof(*s->level_prev));
+    s->fixed_busy = malloc(2 * n * sizeof(*s->fixed_busy));
+    s->fixed_running = malloc(2 * n * sizeof(*s->fixed_running));
+    s->scratch = malloc(2 * n * sizeof(*s->scratch));
+    s->marks = NULL;
+    s->nmarks = 0;
+    if (s->machine_ends == NULL || s->task_ends == NULL ||
+        s->assignments == NULL || s->preds_left == NULL ||
+        s->min_ends == NULL ||
+        s->by_level == NULL || s->level_pos == NULL ||
+        s->level_next == NULL || s->level_prev == NULL ||
+        s->fixed_busy == NULL || s->fixed_running == NULL ||
+        s->scratch == NULL) {
+        goto err7;
     }
     s->g = g;
     s->m = m;
     s->length = 0;
-    s->max_starts = NULL;
-    s->min_ends = NULL;
+    s->work = 0;
+    s->total_work = 0;
+    for (size_t i = 0; i < n; i++) {
+        s->total_work += dag_weight(g, i);
+    }
+    s->path_bound = 0;
+    s->min_free = 0;
+    s->free_m = 0;
+    for (size_t i = 0; i < n; i++) {
+        s->preds_left[i] = dag_npreds(g, i);
+    }
+    // nothing is scheduled yet, so every task can end as soon as its
+    // predecessors allow
+    const unsigned *order = dag_order(g);
+    for (size_t k = 0; k < n; k++) {
+        unsigned i = order[k];
+        size_t npreds = dag_npreds(g, i);
+        unsigned preds[npreds];
+        dag_preds(g, i, preds);
+        unsigned max_min_end = 0;
+        for (size_t j = 0; j < npreds; j++) {
+            max_min_end = (s->min_ends[preds[j]] > max_min_end) ?
+                s->min_ends[preds[j]] : max_min_end;
+        }
+        s->min_ends[i] = max_min_end + dag_weight(g, i);
+    }
+    s->keep_min_ends = 1;
+    s->total_time = dag_level(g, dag_source(g));
+    s->fixed_valid = 0;
+    if (sort_by_level(g, s->by_level) != 0) {
+        goto err7;
+    }
+    for (size_t p = 0; p < n; p++) {
+        s->level_pos[s->by_level[p]] = p;
+        s->level_next[p] = p + 1;
+        s->level_prev[p] = (p == 0) ? n : p - 1;
+    }
+    s->level_next[n] = 0;
+    s->level_prev[n] = n - 1;
+    if (probe_init(s, &s->window) != 0) {
+        goto err7;
+    }
     return s;
+ err7:
+    free(s->machine_ends);
+    free(s->task_ends);
+    free(s->assignments);
+    free(s->preds_left);
+    free(s->min_ends);
+    free(s->by_level);
+    free(s->level_pos);
+    free(s->level_next);
+    free(s->level_prev);
+    free(s->fixed_busy);
+    free(s->fixed_running);
+    free(s->scratch);
+    idx_vec_destroy(&s->fixed_times);
+ err6:
+    idx_vec_destroy(&s->changed);
+ err5:
+    trail_vec_destroy(&s->trail);
+ err4:
+    place_vec_destroy(&s->placements);
+ err3:
+    bitmap_destroy(s->contents);
+ err2:
+    idx_vec_destroy(&s->order);
+ err1:
+    free(s);
+    return NULL;
 }
 
 void schedule_destroy(schedule *s) {
     assert(s != NULL);
     idx_vec_destroy(&s->order);
-    free(s->max_starts);
+    bitmap_destroy(s->contents);
+    place_vec_destroy(&s->placements);
+    trail_vec_destroy(&s->trail);
+    idx_vec_destroy(&s->changed);
+    idx_vec_destroy(&s->fixed_times);
+    probe_destroy(&s->window);
+    free(s->by_level);
+    free(s->level_pos);
+    free(s->level_next);
+    free(s->level_prev);
+    free(s->fixed_busy);
+    free(s->fixed_running);
+    free(s->marks);
+    free(s->scratch);
+    free(s->machine_ends);
+    free(s->task_ends);
+    free(s->assignments);
+    free(s->preds_left);
     free(s->min_ends);
     free(s);
 }
@@ -67,34 +335,195 @@ unsigned schedule_get(schedule *s, unsigned idx) {
     return s->order.data[idx];
 }
 
+schedule *schedule_create_decoder(dag *g, unsigned m) {
+    schedule *s = schedule_create(g, m);
+    if (s != NULL) {
+        s->keep_min_ends = 0;
+    }
+    return s;
+}
+
 unsigned schedule_contains(schedule *s, unsigned idx) {
     assert(s != NULL);
     assert(idx < dag_size(s->g));
     return bitmap_get(s->contents, idx);
 }
 
+// raise the min_ends of the unscheduled descendants of `idx' until
+// they stop changing, logging the old values on the trail.
+static int propagate_min_ends(schedule *s, unsigned idx) {
+    if (idx_vec_push(&s->changed, idx) != 0) {
+        return -1;
+    }
+    while (s->changed.size > 0) {
+        unsigned cur;
+        idx_vec_pop(&s->changed, &cur);
+        size_t nsuccs = dag_nsuccs(s->g, cur);
+        unsigned succs[nsuccs];
+        dag_succs(s->g, cur, succs);
+        for (size_t i = 0; i < nsuccs; i++) {
+            unsigned succ = succs[i];
+            unsigned min_end = s->min_ends[cur] + dag_weight(s->g, succ);
+            if (min_end <= s->min_ends[succ] || schedule_contains(s, succ)) {
+                continue;
+            }
+            trail_entry e = {.idx = succ, .min_end = s->min_ends[succ]};
+            if (trail_vec_push(&s->trail, e) != 0 ||
+                idx_vec_push(&s->changed, succ) != 0) {
+                s->changed.size = 0;
+                return -1;
+            }
+            s->min_ends[succ] = min_end;
+        }
+    }
+    return 0;
+}
+
 int schedule_add(schedule *s, unsigned idx) {
     assert(s != NULL);
     assert(idx < dag_size(s->g));
     assert(s->order.size < dag_size(s->g));
-    if (bitmap_set(s->contents, idx, 1) != 0) {
-        bitmap_set(s->contents, idx, 0);
+    placement p = {
+        .machine_end = 0,
+        .length = s->length,
+        .path_bound = s->path_bound,
+        .min_free = s->min_free,
+        .free_m = s->free_m,
+        .trail_size = s->trail.size,
+    };
+
+    // start on the earliest free machine, unless a predecessor ends
+    // later. In that case follow the predecessor if nothing has been
+    // placed after it on its machine.
+    unsigned cur_time = s->min_free;
+    unsigned cur_m = s->free_m;
+    size_t npreds = dag_npreds(s->g, idx);
+    unsigned preds[npreds];
+    dag_preds(s->g, idx, preds);
+    unsigned max_pred_end = 0;
+    unsigned max_pred_m = 0;
+    for (size_t i = 0; i < npreds; i++) {
+        if (s->task_ends[preds[i]] > max_pred_end) {
+            max_pred_end = s->task_ends[preds[i]];
+            max_pred_m = s->assignments[preds[i]];
+        }
+    }
+    if (max_pred_end > cur_time) {
+        if (s->machine_ends[max_pred_m] <= max_pred_end) {
+            cur_m = max_pred_m;
+        }
+        cur_time = max_pred_end;
+    }
+    p.machine = cur_m;
+    p.machine_end = s->machine_ends[cur_m];
+
+    if (place_vec_push(&s->placements, p) != 0) {
         return -1;
     }
     if (idx_vec_push(&s->order, idx) != 0) {
+        place_vec_pop(&s->placements, NULL);
+        return -1;
+    }
+    if (bitmap_set(s->contents, idx, 1) != 0) {
         bitmap_set(s->contents, idx, 0);
+        idx_vec_pop(&s->order, NULL);
+        place_vec_pop(&s->placements, NULL);
+        return -1;
+    }
+    unsigned end = cur_time + dag_weight(s->g, idx);
+    s->fixed_valid = 0;
+    s->assignments[idx] = cur_m;
+    s->task_ends[idx] = end;
+    s->machine_ends[cur_m] = end;
+    s->work += dag_weight(s->g, idx);
+    s->length = (end > s->length) ? end : s->length;
+    size_t nsuccs = dag_nsuccs(s->g, idx);
+    unsigned succs[nsuccs];
+    dag_succs(s->g, idx, succs);
+    for (size_t i = 0; i < nsuccs; i++) {
+        s->preds_left[succs[i]]--;
+    }
+    // the rest of the longest path through `idx' still has to run
+    unsigned path_end = cur_time + dag_level(s->g, idx);
+    s->path_bound = (path_end > s->path_bound) ? path_end : s->path_bound;
+    s->min_free = UINT_MAX;
+    for (size_t i = 0; i < s->m; i++) {
+        if (s->machine_ends[i] < s->min_free) {
+            s->min_free = s->machine_ends[i];
+            s->free_m = i;
+        }
+    }
+
+#ifdef FUJITA
+    // the sink stays in the level list, where it marks the horizon
+    if (idx != dag_sink(s->g)) {
+        unsigned pos = s->level_pos[idx];
+        s->level_next[s->level_prev[pos]] = s->level_next[pos];
+        s->level_prev[s->level_next[pos]] = s->level_prev[pos];
+    }
+    if (!s->keep_min_ends) {
+        return 0;
+    }
+    if (s->min_ends[idx] != end) {
+        trail_entry e = {.idx = idx, .min_end = s->min_ends[idx]};
+        if (trail_vec_push(&s->trail, e) != 0) {
+            schedule_pop(s);
+            return -1;
+        }
+        s->min_ends[idx] = end;
+    }
+    if (propagate_min_ends(s, idx) != 0) {
+        schedule_pop(s);
         return -1;
     }
+#endif
     return 0;
 }
 
 int schedule_pop(schedule *s) {
     assert(s != NULL);
     assert(s->order.size > 0);
-    bitmap_set(s->contents, s->order.data[s->order.size - 1], 0);
+    unsigned idx = s->order.data[s->order.size - 1];
+    placement p = s->placements.data[s->placements.size - 1];
+    place_vec_pop(&s->placements, NULL);
+    while (s->trail.size > p.trail_size) {
+        trail_entry e;
+        trail_vec_pop(&s->trail, &e);
+        s->min_ends[e.idx] = e.min_end;
+    }
+#ifdef FUJITA
+    // tasks are popped in the reverse order they were added, so the
+    // neighbours `idx' was unlinked from still point past it
+    if (idx != dag_sink(s->g)) {
+        unsigned pos = s->level_pos[idx];
+        s->level_next[s->level_prev[pos]] = pos;
+        s->level_prev[s->level_next[pos]] = pos;
+    }
+#endif
+    bitmap_set(s->contents, idx, 0);
+    size_t nsuccs = dag_nsuccs(s->g, idx);
+    unsigned succs[nsuccs];
+    dag_succs(s->g, idx, succs);
+    for (size_t i = 0; i < nsuccs; i++) {
+        s->preds_left[succs[i]]++;
+    }
+    s->fixed_valid = 0;
+    s->task_ends[idx] = 0;
+    s->machine_ends[p.machine] = p.machine_end;
+    s->work -= dag_weight(s->g, idx);
+    s->length = p.length;
+    s->path_bound = p.path_bound;
+    s->min_free = p.min_free;
+    s->free_m = p.free_m;
     return idx_vec_pop(&s->order, NULL);
 }
 
+unsigned schedule_preds_left(schedule *s, unsigned idx) {
+    assert(s != NULL);
+    assert(idx < dag_size(s->g));
+    return s->preds_left[idx];
+}
+
 size_t schedule_size(schedule *s) {
     assert(s != NULL);
     return s->order.size;
@@ -127,184 +556,43 @@ int schedule_is_valid(schedule *s) {
     return 1;
 }
 
-static int schedule_compute(schedule *s, unsigned *task_ends) {
-    assert(s != NULL);
-    assert(task_ends != NULL);
-    unsigned assignments[dag_size(s->g)];
-    unsigned end_times[s->m];
-    unsigned cur_items[s->m];
-    memset(task_ends, 0, schedule_size(s) * sizeof(*task_ends));
-    memset(assignments, -1, dag_size(s->g) * sizeof(*assignments));
-    memset(end_times, 0, s->m * sizeof(unsigned));
-    memset(cur_items, 0, s->m * sizeof(unsigned));
-    for (size_t i = 0; i < s->order.size; i++) {
-        unsigned cur_time = UINT_MAX;
-        unsigned cur_m = 0;
-        for (size_t i = 0; i < s->m; i++) {
-            if (end_times[i] < cur_time) {
-                cur_time = end_times[i];
-                cur_m = i;
-            }
-        }
-        unsigned idx = s->order.data[i];
-        size_t npreds = dag_npreds(s->g, idx);
-        unsigned preds[npreds];
-        dag_preds(s->g, idx, preds);
-        unsigned max_pred_end = 0;
-        unsigned max_pred_m = 0;
-        for (size_t i = 0; i < npreds; i++) {
-            if (task_ends[preds[i]] > max_pred_end) {
-                max_pred_end = task_ends[preds[i]];
-                max_pred_m = assignments[preds[i]];
-            }
+// gather the windows of the unscheduled tasks into `p' for a schedule
+// of length `total_time'. They only have unscheduled successors, so
+// the latest they can start is their level before the end. Scheduled
+// tasks are pinned to their start times and are accounted for by
+// get_comp_list.
+static void probe_gather(schedule *s, schedule_probe *p,
+                         unsigned total_time) {
+    p->total_time = total_time;
+    p->narrow = p->weights16 != NULL && total_time <= DENSITY16_MAX;
+    size_t n = dag_size(s->g);
+    unsigned sink = dag_sink(s->g);
+    size_t k = 0;
+    for (unsigned pos = s->level_next[n]; pos != n;
+         pos = s->level_next[pos], k++) {
+        unsigned v = s->by_level[pos];
+        unsigned max_start = (v == sink) ? total_time :
+            total_time - dag_level(s->g, v);
+        if (p->narrow) {
+            p->max_starts16[k] = max_start;
+            p->min_ends16[k] = s->min_ends[v];
+            p->weights16[k] = dag_weight(s->g, v);
         }
-        if (max_pred_end > cur_time) {
-            cur_m = max_pred_m;
-            cur_time = max_pred_end;
+        else {
+            p->max_starts[k] = max_start;
+            p->min_ends[k] = s->min_ends[v];
+            p->weights[k] = dag_weight(s->g, v);
         }
-        assignments[idx] = cur_m;
-        task_ends[idx] = cur_time + dag_weight(s->g, idx);
-        end_times[cur_m] = cur_time + dag_weight(s->g, idx);
-    }
-    unsigned final_time = 0;
-    for (size_t i = 0; i < s->m; i++) {
-        final_time = (end_times[i] > final_time) ? end_times[i] : final_time;
     }
-    return final_time;
-}
-
-// calculate min_end
-static void end_visit(dag *g, unsigned idx, idx_vec *end_ready,
-                      bitmap *end_finished, unsigned *min_ends) {
-    size_t nsuccs = dag_nsuccs(g, idx);
-    unsigned succs[nsuccs];
-    dag_succs(g, idx, succs);
-    for (size_t i = 0; i < nsuccs; i++) {
-        unsigned succ = succs[i];
-        if (bitmap_get(end_finished, succ)) {
-            continue;
+    p->nresidual = k;
+    for (; k < density_padded(p->nresidual); k++) {
+        if (p->narrow) {
+            p->weights16[k] = 0;
         }
-        size_t npreds = dag_npreds(g, succ);
-        unsigned preds[npreds];
-        dag_preds(g, succ, preds);
-        int preds_complete = 1;
-        unsigned max_min_end = 0;
-        for (size_t j = 0; j < npreds; j++) {
-            if (bitmap_get(end_finished, preds[j]) != 1) {
-                preds_complete = 0;
-                break;
-            }
-            max_min_end = (min_ends[preds[j]] > max_min_end) ?
-                min_ends[preds[j]] : max_min_end;
-        }
-        // all predecessors have calculated min_ends
-        if (preds_complete) {
-            min_ends[succ] = dag_weight(g, succ) + max_min_end;
-            bitmap_set(end_finished, succ, 1);
-            idx_vec_push(end_ready, succ);
-        }
-    }
-}
-
-// calculate max_start
-static void start_visit(dag *g, unsigned idx, idx_vec *start_ready,
-                        bitmap *start_finished, unsigned *max_starts,
-                        unsigned total_time) {
-    size_t npreds = dag_npreds(g, idx);
-    unsigned preds[npreds];
-    dag_preds(g, idx, preds);
-    for (size_t i = 0; i < npreds; i++) {
-        unsigned pred = preds[i];
-        if (bitmap_get(start_finished, pred)) {
-            continue;
+        else {
+            p->weights[k] = 0;
         }
-        size_t nsuccs = dag_nsuccs(g, pred);
-        unsigned succs[nsuccs];
-        dag_succs(g, pred, succs);
-        int succs_complete = 1;
-        unsigned min_max_start = INT_MAX;
-        for (size_t j = 0; j < nsuccs; j++) {
-            if (bitmap_get(start_finished, succs[j]) != 1) {
-                succs_complete = 0;
-                break;
-            }
-            min_max_start = (max_starts[succs[j]] < min_max_start) ?
-                max_starts[succs[j]] : min_max_start;
-        }
-        // all successors have calculated max_starts
-        if (succs_complete) {
-            max_starts[pred] =
-                (min_max_start - dag_weight(g, pred) < total_time) ?
-                min_max_start - dag_weight(g, pred) : total_time;
-            bitmap_set(start_finished, pred, 1);
-            idx_vec_push(start_ready, pred);
-        }
-    }
-}
-
-static int schedule_min_ends(schedule *s, unsigned *min_ends,
-                             unsigned *sched_ends) {
-    assert(s != NULL);
-    assert(min_ends != NULL);
-    idx_vec end_ready;
-    if (idx_vec_init(&end_ready, 0) != 0) {
-        return -1;
-    }
-    bitmap *end_finished = bitmap_create(dag_size(s->g));
-    if (end_finished == NULL) {
-        return -1;
-    }
-    for (size_t i = 0, nodes = schedule_size(s); i < nodes; i++) {
-        unsigned idx = s->order.data[i];
-        bitmap_set(end_finished, idx, 1);
-        min_ends[idx] = sched_ends[idx];
-        idx_vec_push(&end_ready, idx);
-    }
-    while (end_ready.size > 0) {
-        unsigned idx;
-        idx_vec_pop(&end_ready, &idx);
-        end_visit(s->g, idx, &end_ready, end_finished, min_ends);
-    }
-    idx_vec_destroy(&end_ready);
-    bitmap_destroy(end_finished);
-    return 0;
-}
-
-static int schedule_max_starts(schedule *s, unsigned *max_starts,
-                               unsigned total_time, unsigned *sched_ends) {
-    assert(s != NULL);
-    assert(max_starts != NULL);
-    idx_vec start_ready;
-    if (idx_vec_init(&start_ready, 0) != 0) {
-        return -1;
-    }
-    bitmap *start_finished = bitmap_create(dag_size(s->g));
-    if (start_finished == NULL) {
-        return -1;
     }
-    for (size_t i = 0, nodes = schedule_size(s); i < nodes; i++) {
-        unsigned idx = s->order.data[i];
-        bitmap_set(start_finished, idx, 1);
-        max_starts[idx] = sched_ends[idx] - dag_weight(s->g, idx);
-    }
-
-    max_starts[dag_sink(s->g)] = total_time;
-    bitmap_set(start_finished, dag_sink(s->g), 1);
-    idx_vec_push(&start_ready, dag_sink(s->g));
-    while (start_ready.size > 0) {
-        unsigned idx;
-        idx_vec_pop(&start_ready, &idx);
-        start_visit(s->g, idx, &start_ready, start_finished, max_starts,
-                    total_time);
-    }
-    idx_vec_destroy(&start_ready);
-    bitmap_destroy(start_finished);
-
-    int diff = total_time - dag_level(s->g, dag_source(s->g));
-    for (size_t i = 0; i < dag_size(s->g); i++) {
-        max_starts[i] += diff;
-    }
-    return 0;
 }
 
 int schedule_build(schedule *s, unsigned total_time) {
@@ -312,24 +600,9 @@ int schedule_build(schedule *s, unsigned total_time) {
     if (total_time == 0) {
         total_time = dag_level(s->g, dag_source(s->g));
     }
-    unsigned sched_ends[dag_size(s->g)];
-    s->length = schedule_compute(s, sched_ends);
+    s->total_time = total_time;
 #ifdef FUJITA
-    if (s->max_starts == NULL || s->min_ends == NULL) {
-        s->max_starts = malloc(sizeof(*s->max_starts) * dag_size(s->g));
-        s->min_ends = malloc(sizeof(*s->min_ends) * dag_size(s->g));
-        if (s->max_starts == NULL || s->min_ends == NULL) {
-            free(s->max_starts);
-            free(s->min_ends);
-            return -1;
-        }
-    }
-    if (schedule_max_starts(s, s->max_starts, total_time, sched_ends) != 0) {
-        return -1;
-    }
-    if (schedule_min_ends(s, s->min_ends, sched_ends) != 0) {
-        return -1;
-    }
+    probe_gather(s, &s->window, total_time);
 #endif
     return 0;
 }
@@ -339,10 +612,25 @@ unsigned schedule_length(schedule *s) {
     return s->length;
 }
 
+unsigned schedule_quick_bound(schedule *s) {
+    assert(s != NULL);
+    // no unscheduled task can start before the earliest free machine
+    unsigned remaining = s->total_work - s->work;
+    unsigned work_bound = s->min_free + remaining / s->m +
+        (remaining % s->m != 0);
+    return (s->path_bound > work_bound) ? s->path_bound : work_bound;
+}
+
 unsigned schedule_max_start(schedule *s, unsigned id) {
     assert(s != NULL);
     assert(id < dag_size(s->g));
-    return s->max_starts[id];
+    if (id == dag_sink(s->g)) {
+        return s->total_time;
+    }
+    if (schedule_contains(s, id)) {
+        return s->task_ends[id] - dag_weight(s->g, id);
+    }
+    return s->total_time - dag_level(s->g, id);
 }
 
 unsigned schedule_min_end(schedule *s, unsigned id) {
@@ -351,80 +639,275 @@ unsigned schedule_min_end(schedule *s, unsigned id) {
     return s->min_ends[id];
 }
 
-static void get_comp_list(schedule *s, idx_vec *comp_list) {
-    binheap *sorter = binheap_create();
-    for (size_t i = 0; i < dag_size(s->g); i++) {
-        unsigned max_start = schedule_max_start(s, i);
-        unsigned min_end = schedule_min_end(s, i);
-        binheap_put(sorter, max_start, -((int) max_start));
-        binheap_put(sorter, min_end, -((int) min_end));
+// sort and deduplicate `vals' in place. Small values are bucketed
+// directly, anything else goes through an LSD radix sort.
+static int sort_unique(schedule *s, idx_vec *vals) {
+    unsigned max_val = 0;
+    for (size_t i = 0; i < vals->size; i++) {
+        max_val = (vals->data[i] > max_val) ? vals->data[i] : max_val;
     }
-    idx_vec_push(comp_list, binheap_get(sorter));
-    while (binheap_size(sorter) > 0) {
-        unsigned c = binheap_get(sorter);
-        if (c != comp_list->data[comp_list->size - 1]) {
-            idx_vec_push(comp_list, c);
+    if (max_val <= COUNTING_SLACK * vals->size) {
+        if (s->nmarks <= max_val) {
+            unsigned char *marks = realloc(s->marks, max_val + 1);
+            if (marks == NULL) {
+                return -1;
+            }
+            memset(marks + s->nmarks, 0, max_val + 1 - s->nmarks);
+            s->marks = marks;
+            s->nmarks = max_val + 1;
+        }
+        for (size_t i = 0; i < vals->size; i++) {
+            s->marks[vals->data[i]] = 1;
+        }
+        // leave the marks cleared for the next call
+        vals->size = 0;
+        for (unsigned v = 0; v <= max_val; v++) {
+            if (s->marks[v]) {
+                s->marks[v] = 0;
+                vals->data[vals->size++] = v;
+            }
         }
+        return 0;
     }
-    binheap_destroy(sorter);
+
+    unsigned *src = vals->data;
+    unsigned *dst = s->scratch;
+    int passes = 0;
+    for (unsigned shift = 0; shift < 32 && (max_val >> shift) != 0;
+         shift += 8) {
+        size_t counts[257] = {0};
+        for (size_t i = 0; i < vals->size; i++) {
+            counts[((src[i] >> shift) & 0xff) + 1]++;
+        }
+        for (size_t b = 1; b < 257; b++) {
+            counts[b] += counts[b - 1];
+        }
+        for (size_t i = 0; i < vals->size; i++) {
+            dst[counts[(src[i] >> shift) & 0xff]++] = src[i];
+        }
+        unsigned *tmp = src;
+        src = dst;
+        dst = tmp;
+        passes++;
+    }
+    if (passes % 2 == 1) {
+        memcpy(vals->data, s->scratch, vals->size * sizeof(*vals->data));
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < vals->size; i++) {
+        if (size == 0 || vals->data[i] != vals->data[size - 1]) {
+            vals->data[size++] = vals->data[i];
+        }
+    }
+    vals->size = size;
+    return 0;
 }
 
-static int work_density(schedule *s, unsigned ci, unsigned cj) {
-    assert(s != NULL);
-    int work_density = 0;
-    // TODO: Compute this is constant time
-    for (size_t k = 0, n_nodes = dag_size(s->g); k < n_nodes; k++) {
-        if (schedule_max_start(s, k) < cj &&
-            schedule_min_end(s, k) > ci) {
-            int case1 = schedule_min_end(s, k) - ci;
-            int case2 = dag_weight(s->g, k);
-            int case3 = cj - schedule_max_start(s, k);
-            int case4 = cj - ci;
-            int min1 = (case1 < case2) ? case1 : case2;
-            int min2 = (case3 < case4) ? case3 : case4;
-            work_density += (min1 < min2) ? min1 : min2;
+// returns the index of `t' in the sorted `list', which must hold it.
+static size_t find_time(idx_vec *list, unsigned t) {
+    size_t lo = 0;
+    size_t hi = list->size;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (list->data[mid] <= t) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    assert(list->data[lo] == t);
+    return lo;
+}
+
+// fill in the work done by scheduled tasks before each fixed time and
+// how many of them run from each fixed time to the next. Every start
+// and end of a scheduled task is a fixed time.
+static void fixed_profile(schedule *s) {
+    idx_vec *fixed = &s->fixed_times;
+    unsigned *running = s->fixed_running;
+    memset(running, 0, fixed->size * sizeof(*running));
+    // counts may wrap below zero here, but not once they are summed
+    for (size_t k = 0; k < s->order.size; k++) {
+        unsigned v = s->order.data[k];
+        unsigned w = dag_weight(s->g, v);
+        if (w > 0) {
+            running[find_time(fixed, s->task_ends[v] - w)]++;
+            running[find_time(fixed, s->task_ends[v])]--;
+        }
+    }
+    unsigned busy = 0;
+    unsigned count = 0;
+    for (size_t f = 0; f < fixed->size; f++) {
+        s->fixed_busy[f] = busy;
+        count += running[f];
+        running[f] = count;
+        if (f + 1 < fixed->size) {
+            busy += count * (fixed->data[f + 1] - fixed->data[f]);
+        }
+    }
+}
+
+// append `c' to the sorted comp_list unless it is already at the end,
+// along with the work done by scheduled tasks before it.
+static void push_unique(schedule_probe *p, unsigned c, unsigned busy) {
+    idx_vec *list = &p->comp_list;
+    if (list->size == 0 || list->data[list->size - 1] != c) {
+        p->comp_busy[list->size] = busy;
+        list->data[list->size++] = c;
+    }
+}
+
+// sort the min_ends of all tasks and the start times of scheduled
+// tasks, which do not depend on the horizon.
+static int fix_times(schedule *s) {
+    size_t n = dag_size(s->g);
+    unsigned sink = dag_sink(s->g);
+    idx_vec *fixed = &s->fixed_times;
+    fixed->size = 0;
+    for (size_t i = 0; i < n; i++) {
+        fixed->data[fixed->size++] = s->min_ends[i];
+        if (schedule_contains(s, i) && i != sink) {
+            fixed->data[fixed->size++] =
+                s->task_ends[i] - dag_weight(s->g, i);
         }
     }
-    return work_density;
+    if (sort_unique(s, fixed) != 0) {
+        return -1;
+    }
+    fixed_profile(s);
+    s->fixed_valid = 1;
+    return 0;
+}
+
+// returns the sorted list of distinct max_start and min_end times for
+// the horizon gathered in `p'. Only the max_starts of unscheduled tasks
+// depend on the horizon, so everything else is sorted once per
+// schedule and merged with them on each call.
+static idx_vec *get_comp_list(schedule *s, schedule_probe *p) {
+    size_t n = dag_size(s->g);
+    unsigned sink = dag_sink(s->g);
+    if (!s->fixed_valid && fix_times(s) != 0) {
+        return NULL;
+    }
+
+    // the unscheduled tasks come in order of increasing max_start
+    idx_vec *fixed = &s->fixed_times;
+    p->comp_list.size = 0;
+    size_t i = 0;
+    unsigned pos = s->level_next[n];
+    while (1) {
+        unsigned next = UINT_MAX;
+        if (pos != n) {
+            unsigned v = s->by_level[pos];
+            next = (v == sink) ? p->total_time :
+                p->total_time - dag_level(s->g, v);
+        }
+        while (i < fixed->size && fixed->data[i] <= next) {
+            push_unique(p, fixed->data[i], s->fixed_busy[i]);
+            i++;
+        }
+        if (pos == n) {
+            break;
+        }
+        // the scheduled tasks run at a steady rate between fixed times
+        unsigned busy = (i == 0) ? 0 : s->fixed_busy[i - 1] +
+            s->fixed_running[i - 1] * (next - fixed->data[i - 1]);
+        push_unique(p, next, busy);
+        pos = s->level_next[pos];
+    }
+    return &p->comp_list;
+}
+
+// returns the work that has to be done between the `i'th and `j'th
+// times in comp_list. A scheduled task's window is exactly the time it
+// runs, so the scheduled tasks only add the work they do in between.
+static int schedule_density(schedule_probe *p, size_t i, size_t j) {
+    unsigned ci = p->comp_list.data[i];
+    unsigned cj = p->comp_list.data[j];
+    int density = p->comp_busy[j] - p->comp_busy[i];
+    size_t n = density_padded(p->nresidual);
+    if (p->narrow) {
+        return density + work_density16(p->max_starts16, p->min_ends16,
+                                        p->weights16, n, ci, cj);
+    }
+    return density + work_density(p->max_starts, p->min_ends, p->weights,
+                                  n, ci, cj);
 }
 
 int schedule_fernandez_bound(schedule *s) {
     assert(s != NULL);
-    idx_vec comp_list;
-    idx_vec_init(&comp_list, 0);
-    get_comp_list(s, &comp_list);
+    schedule_probe *p = &s->window;
+    idx_vec *comp_list = get_comp_list(s, p);
+    if (comp_list == NULL) {
+        return -1;
+    }
 
     int max_q = INT_MIN;
-    for (size_t i = 0; i < comp_list.size - 1; i++) {
-        for (size_t j = i + 1; j < comp_list.size; j++) {
-            int w_density = work_density(s, comp_list.data[i],
-                                         comp_list.data[j]);
-            int cur_q = (comp_list.data[i] - comp_list.data[j]) +
+    for (size_t i = 0; i < comp_list->size - 1; i++) {
+        for (size_t j = i + 1; j < comp_list->size; j++) {
+            int w_density = schedule_density(p, i, j);
+            int cur_q = (comp_list->data[i] - comp_list->data[j]) +
                 w_density / s->m + (w_density % s->m != 0);
             max_q = (cur_q > max_q) ? cur_q : max_q;
         }
     }
-    idx_vec_destroy(&comp_list);
     int crit_path = dag_level(s->g, dag_source(s->g));
     return (max_q > 0) ? crit_path + max_q : crit_path;
 }
 
-int schedule_machine_bound(schedule *s) {
-    assert(s != NULL);
-    idx_vec comp_list;
-    idx_vec_init(&comp_list, 0);
-    get_comp_list(s, &comp_list);
+static int machine_bound(schedule *s, schedule_probe *p) {
+    idx_vec *comp_list = get_comp_list(s, p);
+    if (comp_list == NULL) {
+        return -1;
+    }
 
     int max_m = INT_MIN;
-    for (size_t i = 0; i < comp_list.size - 1; i++) {
-        for (size_t j = i + 1; j < comp_list.size; j++) {
-            int w_density = work_density(s, comp_list.data[i],
-                                         comp_list.data[j]);
-            int interval = (comp_list.data[j] - comp_list.data[i]);
+    for (size_t i = 0; i < comp_list->size - 1; i++) {
+        for (size_t j = i + 1; j < comp_list->size; j++) {
+            int w_density = schedule_density(p, i, j);
+            int interval = (comp_list->data[j] - comp_list->data[i]);
             int cur_m = w_density / interval + (w_density % interval != 0);
             max_m = (cur_m > max_m) ? cur_m : max_m;
         }
     }
-    idx_vec_destroy(&comp_list);
     return max_m;
 }
+
+int schedule_machine_bound(schedule *s) {
+    assert(s != NULL);
+    return machine_bound(s, &s->window);
+}
+
+schedule_probe *schedule_probe_create(schedule *s) {
+    assert(s != NULL);
+    schedule_probe *p = malloc(sizeof(*p));
+    if (p == NULL) {
+        return NULL;
+    }
+    if (probe_init(s, p) != 0) {
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void schedule_probe_destroy(schedule_probe *p) {
+    assert(p != NULL);
+    probe_destroy(p);
+    free(p);
+}
+
+int schedule_probe_ready(schedule *s) {
+    assert(s != NULL);
+    return (s->fixed_valid || fix_times(s) == 0) ? 0 : -1;
+}
+
+int schedule_probe_machines(schedule *s, schedule_probe *p,
+                            unsigned total_time) {
+    assert(s != NULL);
+    assert(p != NULL);
+    assert(s->fixed_valid);
+    probe_gather(s, p, total_time);
+    return machine_bound(s, p);
+}
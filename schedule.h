@@ -10,11 +10,23 @@
 struct schedule;
 typedef struct schedule schedule;
 
+// room to work out the machine bound of a schedule at a horizon of its
+// own, so that several horizons can be tried at once on different
+// threads.
+struct schedule_probe;
+typedef struct schedule_probe schedule_probe;
+
 // create an initially empty schedule with the give precedence graph
 // and number of processors. The graph is borrowed, not owned, by the
 // schedule.
 schedule *schedule_create(dag *g, unsigned m);
 
+// same as schedule_create, but the schedule only places tasks and does
+// not keep the min_end times the bounds work from, which makes
+// schedule_add cheaper. Only the order, the placements and the length
+// of such a schedule can be used.
+schedule *schedule_create_decoder(dag *g, unsigned m);
+
 // releases resources associated with the schedule. Does not destroy
 // the dependency graph it contains.
 void schedule_destroy(schedule *s);
@@ -24,10 +36,16 @@ unsigned schedule_m(schedule *s);
 unsigned schedule_get(schedule *s, unsigned idx);
 unsigned schedule_contains(schedule *s, unsigned idx);
 
-// add or remove an item at the end of the schedule.
+// add or remove an item at the end of the schedule. Adding an item
+// places it on a machine and updates the min_end times of the tasks
+// that depend on it; removing it undoes exactly those changes.
 int schedule_add(schedule *s, unsigned idx);
 int schedule_pop(schedule *s);
 
+// returns the number of predecessors of `idx' that are not in the
+// schedule yet. A task is ready once this reaches 0.
+unsigned schedule_preds_left(schedule *s, unsigned idx);
+
 // returns the number of items in the schedule.
 size_t schedule_size(schedule *s);
 
@@ -36,13 +54,20 @@ int schedule_is_complete(schedule *s);
 
 int schedule_is_valid(schedule *s);
 
-// calculates the end times of scheduled items, and the min_end and
-// max_start times for each task, given the `total_time' parameter. If
-// `total_time' is 0, the critical path length is used instead.
+// calculates the max_start times for each task, given the
+// `total_time' parameter. If `total_time' is 0, the critical path
+// length is used instead.
 int schedule_build(schedule *s, unsigned total_time);
 
 unsigned schedule_length(schedule *s);
 
+// returns a lower bound on the length of any completion of the
+// schedule: the longest path through a scheduled task, or the
+// remaining work spread over all machines from the earliest free
+// machine, whichever is larger. Only valid after schedule_build, and
+// runs in constant time.
+unsigned schedule_quick_bound(schedule *s);
+
 #ifdef FUJITA
 unsigned schedule_max_start(schedule *s, unsigned id);
 unsigned schedule_min_end(schedule *s, unsigned id);
@@ -53,6 +78,20 @@ int schedule_fernandez_bound(schedule *s);
 // use Fujita's binary search method
 int schedule_machine_bound(schedule *s);
 
+// create and return a probe for the schedule `s', or NULL on failure.
+schedule_probe *schedule_probe_create(schedule *s);
+void schedule_probe_destroy(schedule_probe *p);
+
+// prepares `s' for schedule_probe_machines after it has changed.
+// Returns 0 on success and -1 on failure.
+int schedule_probe_ready(schedule *s);
+
+// returns what schedule_machine_bound would after schedule_build(s,
+// total_time), but works in `p' and leaves `s' alone. Calls with
+// different probes may run at once.
+int schedule_probe_machines(schedule *s, schedule_probe *p,
+                            unsigned total_time);
+
 #endif // FUJITA
 
 #endif // SCHEDULE_H
@@ -0,0 +1,183 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bbsearch.h"
+#include "cache.h"
+#include "dag.h"
+#include "parser.h"
+#include "threadpool.h"
+#include "serve.h"
+
+#define BACKLOG (64)
+
+typedef struct server {
+    cache *results;
+    pthread_mutex_t lock;
+} server;
+
+typedef struct conn {
+    server *srv;
+    int fd;
+} conn;
+
+static int unix_address(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Socket path too long\n");
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+static void handle(void *arg) {
+    conn *c = arg;
+    server *srv = c->srv;
+    int fd = c->fd;
+    free(c);
+
+    FILE *in = fdopen(fd, "r");
+    if (in == NULL) {
+        close(fd);
+        return;
+    }
+    unsigned m;
+    int timeout;
+    dag *g = NULL;
+    if (fscanf(in, "%u %d", &m, &timeout) != 2 || m == 0 ||
+        parse_patterson_stream(in, &g) != 0) {
+        dprintf(fd, "0 -1 0\n");
+        fclose(in);
+        return;
+    }
+
+    int result;
+    pthread_mutex_lock(&srv->lock);
+    int cached = cache_get(srv->results, g, m, &result) == 0;
+    pthread_mutex_unlock(&srv->lock);
+    if (!cached) {
+        result = bbsearch(g, m, timeout);
+        // time outs and errors depend on the request, not the dag
+        if (result >= 0) {
+            pthread_mutex_lock(&srv->lock);
+            cache_put(srv->results, g, m, result);
+            pthread_mutex_unlock(&srv->lock);
+        }
+    }
+    dprintf(fd, "%zu %d %d\n", dag_size(g) - 2, result, cached);
+    dag_destroy(g);
+    fclose(in);
+}
+
+int serve(const char *path, size_t capacity) {
+    assert(path != NULL);
+    struct sockaddr_un addr;
+    if (unix_address(path, &addr) != 0) {
+        goto err0;
+    }
+    server srv;
+    srv.results = cache_create(capacity);
+    if (srv.results == NULL) {
+        goto err0;
+    }
+    pthread_mutex_init(&srv.lock, NULL);
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threadpool *pool = threadpool_create((ncpus > 0) ? ncpus : 1);
+    if (pool == NULL) {
+        goto err1;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        goto err2;
+    }
+    // a socket left behind by an earlier server would make bind fail
+    unlink(path);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+        listen(sock, BACKLOG) != 0) {
+        perror("serve");
+        goto err3;
+    }
+    // a client hanging up early must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    while (1) {
+        int fd = accept(sock, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        conn *c = malloc(sizeof(*c));
+        if (c == NULL) {
+            close(fd);
+            continue;
+        }
+        *c = (conn) {.srv = &srv, .fd = fd};
+        if (threadpool_submit(pool, handle, c) != 0) {
+            free(c);
+            close(fd);
+        }
+    }
+
+ err3:
+    close(sock);
+ err2:
+    threadpool_destroy(pool);
+ err1:
+    pthread_mutex_destroy(&srv.lock);
+    cache_destroy(srv.results);
+ err0:
+    return -1;
+}
+
+int serve_request(const char *path, FILE *f, unsigned m, int timeout,
+                  size_t *n, int *result, int *cached) {
+    assert(path != NULL);
+    assert(f != NULL);
+    assert(n != NULL && result != NULL);
+    struct sockaddr_un addr;
+    if (unix_address(path, &addr) != 0) {
+        return -1;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        goto err;
+    }
+    char buf[4096];
+    size_t len = snprintf(buf, sizeof(buf), "%u %d\n", m, timeout);
+    // the server replies and hangs up early on a malformed dag, so a
+    // failed send still leaves an answer to read
+    do {
+        if (send(sock, buf, len, MSG_NOSIGNAL) != len) {
+            break;
+        }
+    } while ((len = fread(buf, 1, sizeof(buf), f)) > 0);
+    shutdown(sock, SHUT_WR);
+
+    FILE *in = fdopen(sock, "r");
+    if (in == NULL) {
+        goto err;
+    }
+    int from_cache;
+    int matched = fscanf(in, "%zu %d %d", n, result, &from_cache);
+    fclose(in);
+    if (matched == 3 && cached != NULL) {
+        *cached = from_cache;
+    }
+    return (matched == 3) ? 0 : -1;
+
+ err:
+    close(sock);
+    return -1;
+}
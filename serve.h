@@ -0,0 +1,21 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdio.h>
+
+// answer scheduling requests on the Unix domain socket at `path' until
+// the process is killed, remembering up to `capacity' makespans. Each
+// connection sends a line with m and a timeout in seconds, then a dag
+// in the Patterson format, and gets back a line with the number of
+// vertices (excluding source and sink), the makespan as bbsearch
+// returns it, and 1 if the makespan came from the cache or 0
+// otherwise. Returns -1 if the socket cannot be set up.
+int serve(const char *path, size_t capacity);
+
+// send the dag in `f' to the server at `path' to be scheduled on `m'
+// machines and store the reply in `n', `result' and, unless it is
+// NULL, `cached'. Return 0 on success and -1 on failure.
+int serve_request(const char *path, FILE *f, unsigned m, int timeout,
+                  size_t *n, int *result, int *cached);
+
+#endif // SERVE_H
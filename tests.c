@@ -1,9 +1,21 @@
+#define _POSIX_C_SOURCE 200809L
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
 
+#include <arpa/inet.h>
 #include <assert.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "dag.h"
 #include "bbsearch.h"
@@ -11,6 +23,14 @@
 #include "bitmap.h"
 #include "binheap.h"
 #include "parser.h"
+#include "density.h"
+#include "threadpool.h"
+#include "cache.h"
+#include "generate.h"
+#include "local.h"
+#include "trace.h"
+#include "dist.h"
+#include "serve.h"
 
 /*
 A --> B         I
@@ -69,6 +89,18 @@ void test_dag(void) {
     assert(dag_level(graph, dag_source(graph)) == 48);
     assert(dag_level(graph, g) == 36);
 
+    const unsigned *order = dag_order(graph);
+    assert(order[0] == dag_source(graph));
+    assert(order[dag_size(graph) - 1] == dag_sink(graph));
+    unsigned position[dag_size(graph)];
+    for (unsigned v = 0; v < dag_size(graph); v++) {
+        position[order[v]] = v;
+    }
+    assert(position[a] < position[b] && position[b] < position[e]);
+    assert(position[d] < position[e] && position[e] < position[f]);
+    assert(position[f] < position[h] && position[g] < position[h]);
+    assert(position[h] < position[j] && position[i] < position[j]);
+
     assert(dag_nsuccs(graph, dag_source(graph)) == 3);
     assert(dag_npreds(graph, dag_source(graph)) == 0);
     assert(dag_nsuccs(graph, dag_sink(graph)) == 0);
@@ -134,6 +166,8 @@ void test_schedule(void) {
 
     schedule_build(perm2, 0);
     assert(schedule_length(perm2) == 3);
+    // c starts at 0 and lies on the critical path
+    assert(schedule_quick_bound(perm2) == 48);
 
     schedule_add(perm2, d);
     schedule_add(perm2, e);
@@ -180,6 +214,12 @@ void test_schedule(void) {
     assert(schedule_min_end(perm3, b) == 3);
     assert(schedule_min_end(perm3, e) == 13);
     assert(schedule_min_end(perm3, k) == 49);
+    assert(schedule_preds_left(perm3, e) == 1);
+    assert(schedule_preds_left(perm3, h) == 1);
+    schedule_add(perm3, b);
+    assert(schedule_preds_left(perm3, e) == 0);
+    schedule_pop(perm3);
+    assert(schedule_preds_left(perm3, e) == 1);
 
     assert(schedule_max_start(perm3, g) == 0);
     assert(schedule_max_start(perm3, a) == 0);
@@ -188,6 +228,23 @@ void test_schedule(void) {
     assert(schedule_max_start(perm3, e) == 7);
     assert(schedule_max_start(perm3, dag_sink(graph)) == 48);
 
+    // popping restores the min ends that depended on the popped tasks
+    schedule_pop(perm3);
+    schedule_pop(perm3);
+    assert(schedule_min_end(perm3, d) == 7);
+    assert(schedule_min_end(perm3, e) == 12);
+    assert(schedule_min_end(perm3, k) == 48);
+    schedule_add(perm3, c);
+    schedule_add(perm3, d);
+    assert(schedule_min_end(perm3, e) == 13);
+    assert(schedule_min_end(perm3, k) == 49);
+    assert(schedule_preds_left(perm3, e) == 1);
+    assert(schedule_preds_left(perm3, h) == 1);
+    schedule_add(perm3, b);
+    assert(schedule_preds_left(perm3, e) == 0);
+    schedule_pop(perm3);
+    assert(schedule_preds_left(perm3, e) == 1);
+
     schedule_destroy(perm3);
 #endif
 
@@ -217,9 +274,42 @@ void test_schedule(void) {
     schedule_add(perm6, dag_source(graph));
     int err = schedule_build(perm6, 0);
     assert(err == 0);
+    assert(schedule_quick_bound(perm6) == 8);
     assert(schedule_fernandez_bound(perm6) == 8);
+    // scheduled tasks only count for the time they run
+    schedule_add(perm6, 1);
+    schedule_add(perm6, 2);
+    err = schedule_build(perm6, 0);
+    assert(err == 0);
+    assert(schedule_fernandez_bound(perm6) == 8);
+    assert(schedule_machine_bound(perm6) == 3);
+    schedule_add(perm6, 3);
+    schedule_add(perm6, 4);
+    schedule_add(perm6, 5);
+    err = schedule_build(perm6, 0);
+    assert(err == 0);
+    assert(schedule_fernandez_bound(perm6) == 6);
     schedule_destroy(perm6);
     dag_destroy(graph);
+
+    // same bound with times too spread out to bucket
+    graph = dag_create();
+    assert(graph != NULL);
+    dag_vertex(graph, 500000, 0, NULL);
+    dag_vertex(graph, 200000, 0, NULL);
+    dag_vertex(graph, 200000, 0, NULL);
+    dag_vertex(graph, 200000, 0, NULL);
+    dag_vertex(graph, 200000, 0, NULL);
+    dag_vertex(graph, 200000, 0, NULL);
+    dag_build(graph);
+
+    schedule *perm7 = schedule_create(graph, 2);
+    schedule_add(perm7, dag_source(graph));
+    err = schedule_build(perm7, 0);
+    assert(err == 0);
+    assert(schedule_fernandez_bound(perm7) == 750000);
+    schedule_destroy(perm7);
+    dag_destroy(graph);
 #endif
 }
 
@@ -252,6 +342,76 @@ void test_bbsearch(void) {
 
     dag_build(graph);
     assert(bbsearch(graph, 2, -1) == 48);
+    assert(bbsearch_tiebreak(graph, 2, -1, bb_tiebreak_weight) == 48);
+    assert(bbsearch_tiebreak(graph, 2, -1, bb_tiebreak_succs) == 48);
+    assert(bbsearch_deepening(graph, 1, -1) == 66);
+    assert(bbsearch_deepening(graph, 2, -1) == 48);
+    assert(bbsearch_portfolio(graph, 2, -1, NULL, 0) == 48);
+    bbconfig configs[] = {
+        {.tiebreak = bb_tiebreak_weight, .seed = 3},
+        {.tiebreak = bb_tiebreak_index, .fernandez_only = 1,
+         .deepening = 1},
+    };
+    assert(bbsearch_portfolio(graph, 1, -1, configs, 2) == 66);
+
+    // stops at the root, then starts over from the checkpoint
+    const char *checkpoint = "test_checkpoint.tmp";
+    remove(checkpoint);
+    assert(bbsearch_resumable(graph, 2, 0, checkpoint) == -2);
+    FILE *saved = fopen(checkpoint, "rb");
+    assert(saved != NULL);
+    fclose(saved);
+    assert(bbsearch_resumable(graph, 3, -1, checkpoint) == -1);
+    assert(bbsearch_resumable(graph, 2, -1, checkpoint) == 48);
+    assert(fopen(checkpoint, "rb") == NULL);
+
+    // stops every few nodes somewhere down the tree, and the resumed
+    // searches find the same makespan and count each node once
+    bbstats whole, resumed;
+    assert(bbsearch(graph, 2, -1) == 48);
+    bbsearch_stats(&whole);
+    // each stop makes progress, so there are at most as many as nodes
+    int result = -2;
+    unsigned long stops = 0;
+    for (; result == -2 && stops <= whole.nodes; stops++) {
+        result = bbsearch_resumable_nodes(graph, 2, -1, 5, checkpoint);
+    }
+    assert(result == 48);
+    assert(stops > 2);
+    bbsearch_stats(&resumed);
+    assert(resumed.nodes == whole.nodes);
+    assert(fopen(checkpoint, "rb") == NULL);
+
+    // the subproblems of each first task together give the makespan
+    unsigned source = dag_source(graph);
+    size_t nfirst = dag_nsuccs(graph, source);
+    unsigned first[nfirst];
+    dag_succs(graph, source, first);
+    unsigned shortest = UINT_MAX;
+    for (size_t i = 0; i < nfirst; i++) {
+        bbjob *part = bbsearch_start_prefix(graph, 2, -1, first + i, 1,
+                                            UINT_MAX);
+        assert(part != NULL);
+        int found = bbsearch_join(part);
+        assert(found >= 48);
+        shortest = ((unsigned) found < shortest) ? found : shortest;
+
+        // nothing shorter than an upper bound of 48
+        part = bbsearch_start_prefix(graph, 2, -1, first + i, 1, 48);
+        assert(part != NULL);
+        assert(bbsearch_join(part) == 48);
+    }
+    assert(shortest == 48);
+
+    // a task twice, and the sink before its predecessors
+    unsigned twice[] = {first[0], first[0]};
+    bbjob *part = bbsearch_start_prefix(graph, 2, -1, twice, 2, UINT_MAX);
+    assert(part != NULL);
+    assert(bbsearch_join(part) == -1);
+    unsigned sink = dag_sink(graph);
+    part = bbsearch_start_prefix(graph, 2, -1, &sink, 1, UINT_MAX);
+    assert(part != NULL);
+    assert(bbsearch_join(part) == -1);
     dag_destroy(graph);
 
     graph = dag_create();
@@ -267,7 +427,130 @@ void test_bbsearch(void) {
     assert(bbsearch(graph, 2, -1) == 8);
     assert(bbsearch(graph, 3, -1) == 6);
     assert(bbsearch(graph, 4, -1) == 5);
+    assert(bbsearch_deepening(graph, 2, -1) == 8);
+    assert(bbsearch_deepening(graph, 3, -1) == 6);
+    assert(bbsearch_deepening(graph, 2, 0) == -2);
+    assert(bbsearch_portfolio(graph, 2, -1, NULL, 0) == 8);
+    assert(bbsearch_portfolio(graph, 3, 0, NULL, 0) == -2);
+    assert(bbsearch_restarts(graph, 2, -1, 1) == 8);
+    assert(bbsearch_restarts(graph, 3, 0, 1) == -2);
+
+    int results[5];
+    int err = bbsearch_range(graph, 1, 5, -1, results, NULL);
+    assert(err == 0);
+    assert(results[0] == 15);
+    assert(results[1] == 8);
+    assert(results[2] == 6);
+    assert(results[3] == 5);
+    assert(results[4] == 5);
+
+    bbjob *job2 = bbsearch_start(graph, 2, -1);
+    bbjob *job3 = bbsearch_start(graph, 3, -1);
+    assert(job2 != NULL && job3 != NULL);
+    assert(bbsearch_join(job3) == 6);
+    assert(bbsearch_join(job2) == 8);
+    dag_destroy(graph);
+
+    // small dags are searched with masks of one or two words, larger
+    // ones with bitmaps
+    gen_params params = {
+        .shape = GEN_LAYERED,
+        .density = 0.3,
+        .width = 8,
+        .weights = GEN_UNIFORM,
+        .w_min = 1,
+        .w_max = 10,
+        .seed = 7,
+    };
+    size_t sizes[] = {40, 100, 200};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        params.n = sizes[i];
+        graph = generate(&params);
+        assert(graph != NULL);
+        assert(bbsearch(graph, sizes[i], -1) ==
+               dag_level(graph, dag_source(graph)));
+        dag_destroy(graph);
+
+        graph = dag_create();
+        assert(graph != NULL);
+        for (size_t k = 0; k < sizes[i]; k++) {
+            dag_vertex(graph, 1, 0, NULL);
+        }
+        dag_build(graph);
+        assert(bbsearch(graph, 7, -1) == (sizes[i] + 6) / 7);
+        dag_destroy(graph);
+    }
+
+    // needs a restart, which finds the same makespan
+    err = parse_patterson("series/data1401/Pat18.rcp", &graph);
+    assert(err == 0);
+    bbstats stats;
+    assert(bbsearch_restarts(graph, 4, -1, 1) == 18);
+    bbsearch_stats(&stats);
+    assert(stats.restarts > 0);
+    dag_destroy(graph);
+
+    // far too large to ever finish, so it is always still running when
+    // it is cancelled, and each node is slow enough that the
+    // cancellation has to be seen inside it
+    params.n = 1000;
+    graph = generate(&params);
+    assert(graph != NULL);
+    bbjob *job = bbsearch_start(graph, 4, -1);
+    assert(job != NULL);
+    unsigned best;
+    unsigned long nodes;
+    assert(bbsearch_poll(job, &best, &nodes) == 0);
+    bbsearch_cancel(job);
+    assert(bbsearch_join(job) == -3);
+    dag_destroy(graph);
+
+    // successors of the same task must not share its machine
+    graph = dag_create();
+    assert(graph != NULL);
+    unsigned p = dag_vertex(graph, 5, 0, NULL);
+    dag_vertex(graph, 5, 1, &p);
+    dag_vertex(graph, 5, 1, &p);
+    dag_vertex(graph, 5, 1, &p);
+    dag_build(graph);
+
+    assert(bbsearch(graph, 2, -1) == 15);
+    assert(bbsearch(graph, 3, -1) == 10);
     dag_destroy(graph);
+
+#if defined(FUJITA) && defined(PROBES)
+    // trying several horizons at once gives the same bound as trying
+    // them one after the other, at every depth of random schedules of a
+    // dag large enough for the search to probe in parallel
+    params.n = 45;
+    params.seed = 11;
+    graph = generate(&params);
+    assert(graph != NULL);
+    gen_rng rng = {.state = 5};
+    for (unsigned m = 2; m <= 5; m++) {
+        schedule *s = schedule_create(graph, m);
+        assert(s != NULL);
+        err = schedule_add(s, dag_source(graph));
+        assert(err == 0);
+        while (schedule_size(s) < dag_size(graph)) {
+            int serial = bbsearch_fujita_bound(s, 0);
+            int parallel = bbsearch_fujita_bound(s, 1);
+            assert(serial > 0 && parallel == serial);
+            unsigned ready[dag_size(graph)];
+            size_t nready = 0;
+            for (unsigned v = 0; v < dag_size(graph); v++) {
+                if (!schedule_contains(s, v) &&
+                    schedule_preds_left(s, v) == 0) {
+                    ready[nready++] = v;
+                }
+            }
+            err = schedule_add(s, ready[gen_next(&rng) % nready]);
+            assert(err == 0);
+        }
+        schedule_destroy(s);
+    }
+    dag_destroy(graph);
+#endif // FUJITA && PROBES
 }
 
 void test_parser(void) {
@@ -294,6 +577,180 @@ void test_parser(void) {
     dag_preds(g, 3, &pred);
     assert(pred == 2);
     dag_destroy(g);
+
+    // a stream of the same format, read up to the last vertex line
+    char text[] = "3 0\n\n\n0 1 2\n5 1 3\n0 0\nrest";
+    FILE *in = fmemopen(text, strlen(text), "r");
+    assert(in != NULL);
+    err = parse_patterson_stream(in, &g);
+    assert(err == 0);
+    assert(dag_size(g) == 3);
+    assert(dag_weight(g, 1) == 5);
+    char rest[8];
+    assert(fscanf(in, "%7s", rest) == 1 && strcmp(rest, "rest") == 0);
+    fclose(in);
+    dag_destroy(g);
+
+    const char *bad[] = {
+        // truncated
+        "",
+        "4 0\n",
+        "4 0\n0 1 2\n3 1 3\n",
+        "3 0\n0 2 2",
+        // out of range
+        "3 0\n0 1 2\n5 1 4\n0 0\n",
+        "3 0\n0 1 2\n5 1 2\n0 0\n",
+        "3 0\n0 1 2\n5 -1\n0 0\n",
+        "1 0\n0 0\n",
+        "3 1\n\n0 1 2\n5 1 3\n0 0\n",
+        // far more vertices than lines, which must not be allocated
+        // before their lines are read
+        "2000000 0\n0 1 2\n5 1 3\n",
+        "2147483647 0\n",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(*bad); i++) {
+        // fmemopen may not accept an empty buffer
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%s ", bad[i]);
+        in = fmemopen(buf, strlen(buf), "r");
+        assert(in != NULL);
+        g = NULL;
+        err = parse_patterson_stream(in, &g);
+        assert(err == -1 && g == NULL);
+        fclose(in);
+    }
+}
+
+static void *run_server(void *arg) {
+    serve(arg, 4);
+    return NULL;
+}
+
+// sends `text' to the server at `path', retrying until it is up.
+static int request(const char *path, const char *text, unsigned m,
+                   size_t *n, int *result, int *cached) {
+    while (1) {
+        FILE *f = fmemopen((char *) text, strlen(text), "r");
+        assert(f != NULL);
+        int err = serve_request(path, f, m, -1, n, result, cached);
+        fclose(f);
+        if (err == 0) {
+            return 0;
+        }
+        nanosleep(&(struct timespec) {.tv_nsec = 1000000}, NULL);
+    }
+}
+
+void test_serve(void) {
+    printf("Testing serve\n");
+    const char *path = "test_serve.tmp";
+    // the server runs until the tests exit
+    pthread_t server;
+    int err = pthread_create(&server, NULL, run_server, (char *) path);
+    assert(err == 0);
+    pthread_detach(server);
+
+    dag *g;
+    err = parse_patterson("test.rcp", &g);
+    assert(err == 0);
+    char *text;
+    size_t len;
+    FILE *out = open_memstream(&text, &len);
+    assert(out != NULL);
+    err = write_patterson(g, out);
+    assert(err == 0);
+    fclose(out);
+    int makespan = bbsearch(g, 2, -1);
+
+    size_t n;
+    int result, cached;
+    request(path, text, 2, &n, &result, &cached);
+    assert(n == dag_size(g) - 2 && result == makespan && !cached);
+    // a vertex count far beyond the lines sent is refused, and the
+    // server keeps answering
+    request(path, "2000000 0\n0 1 2\n", 2, &n, &result, &cached);
+    assert(result == -1);
+    request(path, text, 2, &n, &result, &cached);
+    assert(n == dag_size(g) - 2 && result == makespan && cached);
+    request(path, text, 3, &n, &result, &cached);
+    assert(result == bbsearch(g, 3, -1) && !cached);
+    free(text);
+    dag_destroy(g);
+    remove(path);
+}
+
+void test_reduce(void) {
+    printf("Testing reduce\n");
+    dag *graph = dag_create();
+    assert(graph != NULL);
+    unsigned a = dag_vertex(graph, 1, 0, NULL);
+    unsigned b = dag_vertex(graph, 2, 1, &a);
+    unsigned c_deps[] = {a, b};
+    unsigned c = dag_vertex(graph, 3, 2, c_deps);
+    unsigned d_deps[] = {a, c, b};
+    unsigned d = dag_vertex(graph, 4, 3, d_deps);
+    size_t removed;
+    int err = dag_build_reduced(graph, &removed);
+    assert(err == 0);
+    // a -> c, a -> d and b -> d are implied by a -> b -> c -> d
+    assert(removed == 3);
+    assert(dag_nsuccs(graph, a) == 1);
+    assert(dag_nsuccs(graph, b) == 1);
+    assert(dag_npreds(graph, c) == 1);
+    assert(dag_npreds(graph, d) == 1);
+    assert(dag_level(graph, a) == 10);
+    assert(bbsearch(graph, 2, -1) == 10);
+    err = dag_build_reduced(graph, &removed);
+    assert(err == 0 && removed == 0);
+    dag_destroy(graph);
+}
+
+void test_renumber(void) {
+    printf("Testing renumber\n");
+    enum dag_numbering hows[] = {DAG_NUMBER_TOPO, DAG_NUMBER_LEVEL,
+                                 DAG_NUMBER_LAYER};
+    for (size_t h = 0; h < sizeof(hows) / sizeof(*hows); h++) {
+        // c is numbered before b, but b is above it
+        dag *graph = dag_create();
+        assert(graph != NULL);
+        unsigned a = dag_vertex(graph, 1, 0, NULL);
+        unsigned c = dag_vertex(graph, 3, 0, NULL);
+        unsigned b = dag_vertex(graph, 9, 1, &a);
+        unsigned d_deps[] = {b, c};
+        unsigned d = dag_vertex(graph, 4, 2, d_deps);
+        dag_build(graph);
+        int weights[] = {0, 1, 3, 9, 4, 0};
+        int err = dag_renumber(graph, hows[h]);
+        assert(err == 0);
+
+        size_t n = dag_size(graph);
+        assert(dag_input_id(graph, dag_source(graph)) == 0);
+        assert(dag_input_id(graph, dag_sink(graph)) == n - 1);
+        for (unsigned v = 0; v < n; v++) {
+            assert(dag_weight(graph, v) == weights[dag_input_id(graph, v)]);
+            size_t npreds = dag_npreds(graph, v);
+            unsigned preds[npreds];
+            dag_preds(graph, v, preds);
+            for (size_t i = 0; i < npreds; i++) {
+                assert(preds[i] < v);
+            }
+        }
+        if (hows[h] == DAG_NUMBER_LEVEL) {
+            for (unsigned v = 1; v < n; v++) {
+                assert(dag_level(graph, v) <= dag_level(graph, v - 1));
+            }
+            assert(dag_input_id(graph, 1) == a);
+            assert(dag_input_id(graph, 2) == b);
+            assert(dag_input_id(graph, 3) == c);
+        }
+        if (hows[h] == DAG_NUMBER_LAYER) {
+            assert(dag_input_id(graph, 3) == b);
+            assert(dag_input_id(graph, 4) == d);
+        }
+        assert(bbsearch(graph, 1, -1) == 17);
+        assert(bbsearch(graph, 2, -1) == 14);
+        dag_destroy(graph);
+    }
 }
 
 void test_bitmap(void) {
@@ -341,6 +798,15 @@ void test_bitmap(void) {
     bitmap_set(bm, 10000, 1);
     assert(bitmap_get(bm, 10000) == 1);
 
+    bitmap_set(bm, 31, 1);
+    bitmap_set(bm, 32, 1);
+    assert(bitmap_next(bm, 0) == 31);
+    assert(bitmap_next(bm, 31) == 31);
+    assert(bitmap_next(bm, 32) == 32);
+    assert(bitmap_next(bm, 33) == 10000);
+    assert(bitmap_next(bm, 10001) == -1);
+    assert(bitmap_next(bm, 100000) == -1);
+
     bitmap_destroy(bm);
 }
 
@@ -377,13 +843,413 @@ void test_binheap(void) {
     binheap_destroy(heap);
 }
 
+void test_density(void) {
+    printf("Testing density\n");
+    int32_t max_starts[3 * DENSITY_PAD] = {0};
+    int32_t min_ends[3 * DENSITY_PAD] = {0};
+    int32_t weights[3 * DENSITY_PAD] = {0};
+    int16_t max_starts16[3 * DENSITY_PAD] = {0};
+    int16_t min_ends16[3 * DENSITY_PAD] = {0};
+    int16_t weights16[3 * DENSITY_PAD] = {0};
+    srand(224);
+    for (size_t n = 0; n <= 2 * DENSITY_PAD + 1; n++) {
+        for (size_t k = 0; k < n; k++) {
+            weights[k] = rand() % 10;
+            max_starts[k] = rand() % 20;
+            min_ends[k] = weights[k] + rand() % 20;
+            max_starts16[k] = max_starts[k];
+            min_ends16[k] = min_ends[k];
+            weights16[k] = weights[k];
+        }
+        for (int ci = 0; ci < 25; ci++) {
+            for (int cj = ci + 1; cj < 30; cj++) {
+                int expected = 0;
+                for (size_t k = 0; k < n; k++) {
+                    if (max_starts[k] < cj && min_ends[k] > ci) {
+                        int min = min_ends[k] - ci;
+                        min = (weights[k] < min) ? weights[k] : min;
+                        min = (cj - max_starts[k] < min) ?
+                            cj - max_starts[k] : min;
+                        min = (cj - ci < min) ? cj - ci : min;
+                        expected += min;
+                    }
+                }
+                assert(work_density(max_starts, min_ends, weights,
+                                    density_padded(n), ci, cj) == expected);
+                assert(work_density16(max_starts16, min_ends16, weights16,
+                                      density_padded(n), ci, cj) == expected);
+            }
+        }
+    }
+}
+
+static dag *cache_dag(int weight) {
+    dag *g = dag_create();
+    assert(g != NULL);
+    unsigned a = dag_vertex(g, weight, 0, NULL);
+    dag_vertex(g, 2, 1, &a);
+    dag_vertex(g, 3, 0, NULL);
+    dag_build(g);
+    return g;
+}
+
+void test_cache(void) {
+    printf("Testing cache\n");
+    cache *c = cache_create(2);
+    assert(c != NULL);
+    dag *g1 = cache_dag(1);
+    dag *g2 = cache_dag(2);
+    int result;
+
+    assert(cache_get(c, g1, 2, &result) == -1);
+    assert(cache_put(c, g1, 2, 5) == 0);
+    assert(cache_get(c, g1, 2, &result) == 0);
+    assert(result == 5);
+    assert(cache_get(c, g1, 3, &result) == -1);
+    assert(cache_get(c, g2, 2, &result) == -1);
+
+    // an identical dag built separately shares the entry
+    dag *same = cache_dag(1);
+    assert(cache_get(c, same, 2, &result) == 0);
+    assert(result == 5);
+    assert(cache_put(c, same, 2, 6) == 0);
+    assert(cache_size(c) == 1);
+
+    // (g1, 2) was used more recently than (g2, 2), so (g1, 3) evicts
+    // (g2, 2)
+    assert(cache_put(c, g2, 2, 7) == 0);
+    assert(cache_get(c, g1, 2, &result) == 0);
+    assert(result == 6);
+    assert(cache_put(c, g1, 3, 4) == 0);
+    assert(cache_size(c) == 2);
+    assert(cache_get(c, g2, 2, &result) == -1);
+    assert(cache_get(c, g1, 3, &result) == 0);
+    assert(result == 4);
+    assert(cache_get(c, g1, 2, &result) == 0);
+
+    dag_destroy(same);
+    dag_destroy(g2);
+    dag_destroy(g1);
+    cache_destroy(c);
+}
+
+void test_generate(void) {
+    printf("Testing generate\n");
+    gen_params p = {
+        .n = 30,
+        .density = 0.3,
+        .width = 4,
+        .weights = GEN_EXPONENTIAL,
+        .w_min = 1,
+        .w_max = 10,
+        .seed = 42,
+    };
+    enum gen_shape shapes[] = {GEN_LAYERED, GEN_RANDOM, GEN_SERIES_PARALLEL,
+                               GEN_FORK_JOIN, GEN_CHAIN};
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(*shapes); i++) {
+        p.shape = shapes[i];
+        dag *g = generate(&p);
+        assert(g != NULL);
+        assert(dag_size(g) == p.n + 2);
+        for (unsigned v = 1; v <= p.n; v++) {
+            assert(dag_weight(g, v) >= p.w_min && dag_weight(g, v) <= p.w_max);
+        }
+        dag *same = generate(&p);
+        assert(dag_hash(same) == dag_hash(g));
+        dag_destroy(same);
+
+        // writing the dag out and reading it back changes nothing
+        FILE *f = tmpfile();
+        assert(f != NULL);
+        int err = write_patterson(g, f);
+        assert(err == 0);
+        rewind(f);
+        dag *read;
+        err = parse_patterson_stream(f, &read);
+        assert(err == 0);
+        assert(dag_hash(read) == dag_hash(g));
+        fclose(f);
+        dag_destroy(read);
+        dag_destroy(g);
+    }
+}
+
+static void count_task(void *arg) {
+    atomic_fetch_add((atomic_int *) arg, 1);
+}
+
+void test_local(void) {
+    printf("Testing local\n");
+    gen_params params = {
+        .shape = GEN_LAYERED,
+        .n = 40,
+        .density = 0.3,
+        .width = 6,
+        .weights = GEN_UNIFORM,
+        .w_min = 1,
+        .w_max = 10,
+        .seed = 3,
+    };
+    dag *graph = generate(&params);
+    assert(graph != NULL);
+    size_t n = dag_size(graph);
+    unsigned order[n];
+    unsigned again[n];
+    int opt = bbsearch(graph, 3, -1);
+    int len = local_search(graph, 3, -1, 2000, 5, order);
+    assert(len >= opt);
+    assert(local_search(graph, 3, -1, 2000, 5, again) == len);
+    for (size_t i = 0; i < n; i++) {
+        assert(order[i] == again[i]);
+    }
+    // the order is one schedule_add accepts and gives the same makespan
+    schedule *s = schedule_create(graph, 3);
+    assert(s != NULL);
+    for (size_t i = 0; i < n; i++) {
+        assert(schedule_preds_left(s, order[i]) == 0);
+        assert(schedule_add(s, order[i]) == 0);
+    }
+    assert(schedule_is_valid(s));
+    assert((int) schedule_length(s) == len);
+    schedule_destroy(s);
+
+    // and places the tasks the same without the min_ends
+    s = schedule_create_decoder(graph, 3);
+    assert(s != NULL);
+    for (size_t i = 0; i < n; i++) {
+        assert(schedule_add(s, order[i]) == 0);
+    }
+    assert((int) schedule_length(s) == len);
+    for (size_t i = n; i-- > n / 2;) {
+        schedule_pop(s);
+    }
+    for (size_t i = n / 2; i < n; i++) {
+        assert(schedule_add(s, order[i]) == 0);
+    }
+    assert((int) schedule_length(s) == len);
+    schedule_destroy(s);
+
+    // never worse than where it starts, and no time means no moves
+    int start = local_search(graph, 3, 0, 0, 5, NULL);
+    assert(start >= len);
+    assert(local_search(graph, 3, 0, 2000, 5, NULL) == start);
+    unsigned found;
+    assert(bbsearch_local(graph, 3, -1, &found) == opt);
+    assert(found == (unsigned) opt);
+
+    // out of time, but the local search's schedule is kept
+    assert(bbsearch_local(graph, 3, 0, &found) == -2);
+    assert(found == (unsigned) start);
+    dag_destroy(graph);
+
+    // stops once it reaches the work bound
+    graph = dag_create();
+    assert(graph != NULL);
+    dag_vertex(graph, 5, 0, NULL);
+    for (int i = 0; i < 5; i++) {
+        dag_vertex(graph, 2, 0, NULL);
+    }
+    dag_build(graph);
+    assert(local_search(graph, 2, -1, 1000, 1, NULL) == 8);
+    assert(bbsearch_local(graph, 2, -1, NULL) == 8);
+    dag_destroy(graph);
+}
+
+void test_trace(void) {
+    printf("Testing trace\n");
+    const char *path = "test_trace.tmp";
+    trace *t = trace_open(path);
+    assert(t != NULL);
+    trace_buffer *b1 = trace_buffer_create(t);
+    trace_buffer *b2 = trace_buffer_create(t);
+    assert(b1 != NULL && b2 != NULL);
+    trace_event(b2, TRACE_INCUMBENT, 3, 7, TRACE_COMPLETE, 12);
+    trace_buffer_destroy(b2);
+    // more events than fit in a buffer at once
+    for (unsigned i = 0; i < 10000; i++) {
+        trace_event(b1, TRACE_NODE, i, i + 1, TRACE_FERNANDEZ, 20);
+    }
+    trace_buffer_destroy(b1);
+    assert(trace_close(t) == 0);
+
+    FILE *in = fopen(path, "rb");
+    FILE *out = tmpfile();
+    assert(in != NULL && out != NULL);
+    assert(trace_decode(in, out) == 0);
+    rewind(out);
+    unsigned id, depth, task, value;
+    unsigned long long time;
+    char kind[16], reason[16];
+    assert(fscanf(out, "%u, %llu, %15[a-z], %u, %u, %15[a-z], %u\n", &id,
+                  &time, kind, &depth, &task, reason, &value) == 7);
+    assert(id == 1 && depth == 3 && task == 7 && value == 12);
+    assert(strcmp(kind, "incumbent") == 0);
+    assert(strcmp(reason, "complete") == 0);
+    unsigned long prev = 0;
+    for (unsigned i = 0; i < 10000; i++) {
+        assert(fscanf(out, "%u, %llu, %15[a-z], %u, %u, %15[a-z], %u\n",
+                      &id, &time, kind, &depth, &task, reason, &value) == 7);
+        assert(id == 0 && depth == i && task == i + 1 && value == 20);
+        assert(strcmp(reason, "fernandez") == 0);
+        assert(time >= prev);
+        prev = time;
+    }
+    assert(fgetc(out) == EOF);
+    fclose(out);
+    fclose(in);
+
+    // one node event per node searched
+    dag *graph;
+    int err = parse_patterson("series/data1401/Pat7.rcp", &graph);
+    assert(err == 0);
+    assert(bbsearch_trace(path) == 0);
+    assert(bbsearch(graph, 4, -1) == 26);
+    assert(bbsearch_trace(NULL) == 0);
+    bbstats stats;
+    bbsearch_stats(&stats);
+    in = fopen(path, "rb");
+    out = tmpfile();
+    assert(in != NULL && out != NULL);
+    assert(trace_decode(in, out) == 0);
+    rewind(out);
+    unsigned long nodes = 0;
+    unsigned best = UINT_MAX;
+    while (fscanf(out, "%u, %llu, %15[a-z], %u, %u, %15[a-z], %u\n", &id,
+                  &time, kind, &depth, &task, reason, &value) == 7) {
+        if (strcmp(kind, "node") == 0) {
+            nodes++;
+        }
+        else {
+            assert(value < best);
+            best = value;
+        }
+    }
+    assert(nodes == stats.nodes);
+    assert(best == 26);
+    fclose(out);
+    fclose(in);
+    dag_destroy(graph);
+    remove(path);
+}
+
+void test_threadpool(void) {
+    printf("Testing threadpool\n");
+    threadpool *pool = threadpool_create(3);
+    assert(pool != NULL);
+    assert(threadpool_size(pool) == 3);
+    atomic_int count = 0;
+    for (int i = 0; i < 100; i++) {
+        assert(threadpool_submit(pool, count_task, &count) == 0);
+    }
+    // queued tasks still run before the workers stop
+    threadpool_destroy(pool);
+    assert(atomic_load(&count) == 100);
+}
+
+typedef struct coordinator {
+    dag *g;
+    unsigned m;
+    char port[16];
+    int result;
+} coordinator;
+
+static void *run_coordinator(void *arg) {
+    coordinator *co = arg;
+    co->result = dist_coordinate(co->g, co->m, -1, co->port);
+    return NULL;
+}
+
+static void *run_worker(void *arg) {
+    dist_work("127.0.0.1", arg);
+    return NULL;
+}
+
+// stores in `port' a local TCP port that nothing listens on
+static void free_port(char *port, size_t size) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    assert(sock >= 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    int err = bind(sock, (struct sockaddr *) &addr, sizeof(addr));
+    assert(err == 0);
+    err = getsockname(sock, (struct sockaddr *) &addr, &len);
+    assert(err == 0);
+    snprintf(port, size, "%u", ntohs(addr.sin_port));
+    close(sock);
+}
+
+// waits until something listens on the local `port'
+static void wait_listening(const char *port) {
+    struct sockaddr_in addr = {.sin_family = AF_INET};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(atoi(port));
+    while (1) {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        assert(sock >= 0);
+        int err = connect(sock, (struct sockaddr *) &addr, sizeof(addr));
+        close(sock);
+        if (err == 0) {
+            return;
+        }
+        nanosleep(&(struct timespec) {.tv_nsec = 1000000}, NULL);
+    }
+}
+
+void test_dist(void) {
+    printf("Testing dist\n");
+#ifdef FUJITA
+    // without the bounds, the subproblems that cannot reach the lower
+    // bound at the root are searched in full
+    struct {
+        const char *path;
+        int makespan;
+    } cases[] = {
+        {"series/data1301/Pat7.rcp", 18},
+        {"series/data1301/Pat29.rcp", 21},
+        {"series/data1401/Pat4.rcp", 22},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+        coordinator co = {.m = 4};
+        int err = parse_patterson(cases[i].path, &co.g);
+        assert(err == 0);
+        free_port(co.port, sizeof(co.port));
+        // the coordinator drops the connection that only checks on it
+        pthread_t coord, workers[2];
+        err = pthread_create(&coord, NULL, run_coordinator, &co);
+        assert(err == 0);
+        wait_listening(co.port);
+        for (size_t k = 0; k < 2; k++) {
+            err = pthread_create(&workers[k], NULL, run_worker, co.port);
+            assert(err == 0);
+        }
+        pthread_join(coord, NULL);
+        for (size_t k = 0; k < 2; k++) {
+            pthread_join(workers[k], NULL);
+        }
+        assert(co.result == cases[i].makespan);
+        dag_destroy(co.g);
+    }
+#endif // FUJITA
+}
+
 int main(void) {
     test_dag();
+    test_reduce();
+    test_renumber();
     test_bitmap();
     test_binheap();
+    test_density();
+    test_threadpool();
+    test_cache();
+    test_generate();
     test_schedule();
     test_bbsearch();
+    test_dist();
+    test_local();
+    test_trace();
     test_parser();
+    test_serve();
 }
 
 #pragma GCC diagnostic pop
@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "vector.h"
+#include "threadpool.h"
+
+typedef struct task {
+    void (*fn)(void *);
+    void *arg;
+} task;
+
+DECLARE_VECTOR(task_vec, task);
+DEFINE_VECTOR(task_vec, task);
+
+struct threadpool {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    // tasks before `head' have already been taken by a worker
+    task_vec tasks;
+    size_t head;
+    int stop;
+    size_t nthreads;
+    pthread_t *threads;
+};
+
+static void *worker(void *arg) {
+    threadpool *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->head == pool->tasks.size && !pool->stop) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->head == pool->tasks.size) {
+            break;
+        }
+        task t = pool->tasks.data[pool->head++];
+        if (pool->head == pool->tasks.size) {
+            pool->head = 0;
+            pool->tasks.size = 0;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        t.fn(t.arg);
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+threadpool *threadpool_create(size_t nthreads) {
+    assert(nthreads > 0);
+    threadpool *pool = malloc(sizeof(*pool));
+    if (pool == NULL) {
+        goto err0;
+    }
+    pool->threads = malloc(nthreads * sizeof(*pool->threads));
+    if (pool->threads == NULL) {
+        goto err1;
+    }
+    if (task_vec_init(&pool->tasks, 0) != 0) {
+        goto err2;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pool->head = 0;
+    pool->stop = 0;
+    for (pool->nthreads = 0; pool->nthreads < nthreads; pool->nthreads++) {
+        if (pthread_create(&pool->threads[pool->nthreads], NULL, worker,
+                           pool) != 0) {
+            goto err3;
+        }
+    }
+    return pool;
+
+ err3:
+    // the workers started so far are joined before the pool is freed
+    threadpool_destroy(pool);
+    return NULL;
+ err2:
+    free(pool->threads);
+ err1:
+    free(pool);
+ err0:
+    return NULL;
+}
+
+void threadpool_destroy(threadpool *pool) {
+    assert(pool != NULL);
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    task_vec_destroy(&pool->tasks);
+    free(pool->threads);
+    free(pool);
+}
+
+size_t threadpool_size(threadpool *pool) {
+    assert(pool != NULL);
+    return pool->nthreads;
+}
+
+int threadpool_submit(threadpool *pool, void (*fn)(void *), void *arg) {
+    assert(pool != NULL);
+    assert(fn != NULL);
+    pthread_mutex_lock(&pool->lock);
+    int err = task_vec_push(&pool->tasks, (task) {.fn = fn, .arg = arg});
+    if (err == 0) {
+        pthread_cond_signal(&pool->wake);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return (err == 0) ? 0 : -1;
+}
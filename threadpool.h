@@ -0,0 +1,24 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stdlib.h>
+
+struct threadpool;
+typedef struct threadpool threadpool;
+
+// create a pool of `nthreads' worker threads that run submitted tasks
+// in the order they were submitted. Returns NULL on failure.
+threadpool *threadpool_create(size_t nthreads);
+
+// run the tasks still queued, then stop the workers and clean up
+// resources associated with the pool.
+void threadpool_destroy(threadpool *pool);
+
+// returns the number of worker threads in the pool.
+size_t threadpool_size(threadpool *pool);
+
+// queue `fn(arg)' to run on one of the workers. Return 0 on success
+// and -1 on failure.
+int threadpool_submit(threadpool *pool, void (*fn)(void *), void *arg);
+
+#endif // THREADPOOL_H
@@ -0,0 +1,171 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "trace.h"
+
+#define TRACE_MAGIC (0x52544242) // "BBTR"
+#define TRACE_VERSION (1)
+
+// events a buffer holds before it is written out
+#define TRACE_BUFFER_SIZE (4096)
+
+// an event as it is stored in the file. The file is a header of magic
+// and version, followed by chunks of a buffer number, an event count
+// and that many events, all in native byte order.
+typedef struct trace_record {
+    uint64_t time;
+    uint32_t task;
+    uint32_t value;
+    uint32_t depth;
+    uint8_t kind;
+    uint8_t reason;
+    uint16_t unused;
+} trace_record;
+
+struct trace {
+    FILE *f;
+    pthread_mutex_t lock;
+    uint64_t start;
+    atomic_uint next_id;
+    int failed;
+};
+
+struct trace_buffer {
+    trace *t;
+    uint32_t id;
+    uint32_t count;
+    trace_record records[TRACE_BUFFER_SIZE];
+};
+
+static const char *kinds[] = {
+    [TRACE_NODE] = "node",
+    [TRACE_INCUMBENT] = "incumbent",
+};
+
+static const char *reasons[] = {
+    [TRACE_BRANCHED] = "branched",
+    [TRACE_COMPLETE] = "complete",
+    [TRACE_QUICK] = "quick",
+    [TRACE_FERNANDEZ] = "fernandez",
+    [TRACE_FUJITA] = "fujita",
+};
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+trace *trace_open(const char *path) {
+    assert(path != NULL);
+    trace *t = malloc(sizeof(*t));
+    if (t == NULL) {
+        return NULL;
+    }
+    t->f = fopen(path, "wb");
+    if (t->f == NULL) {
+        free(t);
+        return NULL;
+    }
+    uint32_t header[] = {TRACE_MAGIC, TRACE_VERSION};
+    if (fwrite(header, sizeof(header), 1, t->f) != 1) {
+        fclose(t->f);
+        free(t);
+        return NULL;
+    }
+    pthread_mutex_init(&t->lock, NULL);
+    t->start = now();
+    atomic_init(&t->next_id, 0);
+    t->failed = 0;
+    return t;
+}
+
+int trace_close(trace *t) {
+    assert(t != NULL);
+    int failed = t->failed;
+    failed |= fclose(t->f) != 0;
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+    return failed ? -1 : 0;
+}
+
+trace_buffer *trace_buffer_create(trace *t) {
+    assert(t != NULL);
+    trace_buffer *b = malloc(sizeof(*b));
+    if (b == NULL) {
+        return NULL;
+    }
+    b->t = t;
+    b->id = atomic_fetch_add(&t->next_id, 1);
+    b->count = 0;
+    return b;
+}
+
+// writes out the events in the buffer as one chunk and empties it.
+static void flush(trace_buffer *b) {
+    if (b->count == 0) {
+        return;
+    }
+    trace *t = b->t;
+    uint32_t chunk[] = {b->id, b->count};
+    pthread_mutex_lock(&t->lock);
+    int ok = fwrite(chunk, sizeof(chunk), 1, t->f) == 1 &&
+        fwrite(b->records, sizeof(*b->records), b->count, t->f) == b->count;
+    t->failed |= !ok;
+    pthread_mutex_unlock(&t->lock);
+    b->count = 0;
+}
+
+void trace_buffer_destroy(trace_buffer *b) {
+    assert(b != NULL);
+    flush(b);
+    free(b);
+}
+
+void trace_event(trace_buffer *b, enum trace_kind kind, unsigned depth,
+                 unsigned task, enum trace_reason reason, unsigned value) {
+    assert(b != NULL);
+    b->records[b->count++] = (trace_record) {
+        .time = now() - b->t->start,
+        .task = task,
+        .value = value,
+        .depth = depth,
+        .kind = kind,
+        .reason = reason,
+    };
+    if (b->count == TRACE_BUFFER_SIZE) {
+        flush(b);
+    }
+}
+
+int trace_decode(FILE *in, FILE *out) {
+    assert(in != NULL);
+    assert(out != NULL);
+    uint32_t header[2];
+    if (fread(header, sizeof(header), 1, in) != 1 ||
+        header[0] != TRACE_MAGIC || header[1] != TRACE_VERSION) {
+        return -1;
+    }
+    uint32_t chunk[2];
+    while (fread(chunk, sizeof(chunk), 1, in) == 1) {
+        for (uint32_t i = 0; i < chunk[1]; i++) {
+            trace_record r;
+            if (fread(&r, sizeof(r), 1, in) != 1 ||
+                r.kind >= sizeof(kinds) / sizeof(*kinds) ||
+                r.reason >= sizeof(reasons) / sizeof(*reasons)) {
+                return -1;
+            }
+            fprintf(out, "%u, %llu, %s, %u, %u, %s, %u\n", chunk[0],
+                    (unsigned long long) r.time, kinds[r.kind], r.depth,
+                    r.task, reasons[r.reason], r.value);
+        }
+    }
+    return ferror(in) ? -1 : 0;
+}
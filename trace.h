@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// A file that searches on any number of threads record what they do
+// in. Each search appends to a buffer of its own without locking, and
+// only takes the file's lock to write the buffer out once it is full.
+struct trace;
+typedef struct trace trace;
+
+struct trace_buffer;
+typedef struct trace_buffer trace_buffer;
+
+enum trace_kind {
+    // a search node, settled as `reason' says
+    TRACE_NODE,
+    // a shorter schedule was found; `value' is its makespan
+    TRACE_INCUMBENT,
+};
+
+// how a node was settled. Nodes that are neither complete nor pruned
+// are branched on.
+enum trace_reason {
+    TRACE_BRANCHED,
+    TRACE_COMPLETE,
+    TRACE_QUICK,
+    TRACE_FERNANDEZ,
+    TRACE_FUJITA,
+};
+
+// create the file `path' and return a trace that writes to it, or NULL
+// on failure.
+trace *trace_open(const char *path);
+
+// closes the file. Every buffer of the trace must have been destroyed.
+// Returns 0 if everything was written and -1 otherwise.
+int trace_close(trace *t);
+
+// returns a buffer for one thread to record events in, or NULL on
+// failure. The events are tagged with a number unique to the buffer.
+trace_buffer *trace_buffer_create(trace *t);
+
+// writes out the events still in the buffer and frees it.
+void trace_buffer_destroy(trace_buffer *b);
+
+// records an event at depth `depth' of the search, after scheduling
+// `task'. `value' is the largest lower bound tried for nodes and the
+// makespan for incumbents.
+void trace_event(trace_buffer *b, enum trace_kind kind, unsigned depth,
+                 unsigned task, enum trace_reason reason, unsigned value);
+
+// writes the events in the trace file `in' to `out' as comma
+// separated lines of buffer number, nanoseconds since the trace was
+// opened, kind, depth, task, reason and value. Returns 0 on success and
+// -1 if `in' is not a trace or cannot be read.
+int trace_decode(FILE *in, FILE *out);
+
+#endif // TRACE_H